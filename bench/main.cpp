@@ -0,0 +1,718 @@
+#include "../src/signals.hpp"
+#include <chrono>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <new>
+#include <atomic>
+
+USE_SS;
+using namespace std;
+
+// 性能测试，每项测试重复若干轮，取单次操作耗时(ns)的中位数，结果以json格式输出
+
+typedef chrono::steady_clock bench_clock;
+
+static const size_t ROUNDS = 5;
+
+static volatile size_t sink = 0;
+
+struct Result {
+    string name;
+    size_t n;
+    size_t iterations;
+    double ns;
+};
+
+static vector<Result> results;
+
+// 内存占用，对象本身加上构造时分配的字节数
+struct Footprint {
+    string name;
+    size_t n;
+    double bytes;
+};
+
+static vector<Footprint> footprints;
+
+// 当前编译模式下没有意义而跳过的测试，在json中注明原因
+struct Skipped {
+    string name;
+    string reason;
+};
+
+static vector<Skipped> skipped;
+
+// 累计通过 operator new 分配的字节数，只在统计内存占用时打开，计时的测试只多一次读取
+// 通道的消费者和线程池的线程同时在分配，计数使用原子变量
+static atomic<bool> counting(false);
+static atomic<size_t> allocated(0);
+
+// 替换全部的分配和释放函数，都使用 malloc/free，对齐的版本使用 aligned_alloc，同样使用 free 释放
+static void *allocate(size_t size, size_t align = 0) noexcept
+{
+    if (counting.load(memory_order_relaxed))
+        allocated.fetch_add(size, memory_order_relaxed);
+    if (!size)
+        size = 1;
+    if (!align)
+        return malloc(size);
+    return aligned_alloc(align, (size + align - 1) / align * align);
+}
+
+// 不内联，否则编译器在调用处看到 free 释放 new 的结果会误报 -Wmismatched-new-delete
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static void deallocate(void *p) noexcept
+{
+    free(p);
+}
+
+void *operator new(size_t size)
+{
+    void *p = allocate(size);
+    if (!p)
+        throw bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, nothrow_t const &) noexcept
+{
+    return allocate(size);
+}
+
+void *operator new[](size_t size, nothrow_t const &) noexcept
+{
+    return allocate(size);
+}
+
+void *operator new(size_t size, align_val_t align)
+{
+    void *p = allocate(size, (size_t)align);
+    if (!p)
+        throw bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size, align_val_t align)
+{
+    return operator new(size, align);
+}
+
+void *operator new(size_t size, align_val_t align, nothrow_t const &) noexcept
+{
+    return allocate(size, (size_t)align);
+}
+
+void *operator new[](size_t size, align_val_t align, nothrow_t const &) noexcept
+{
+    return allocate(size, (size_t)align);
+}
+
+void operator delete(void *p) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete(void *p, nothrow_t const &) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void *p, nothrow_t const &) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete(void *p, align_val_t) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void *p, align_val_t) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete(void *p, size_t, align_val_t) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void *p, size_t, align_val_t) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete(void *p, align_val_t, nothrow_t const &) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void *p, align_val_t, nothrow_t const &) noexcept
+{
+    deallocate(p);
+}
+
+// fn(iterations) 执行iterations次操作，返回本轮耗时(ns)
+template<typename F>
+static void measure(string const &name, size_t n, size_t iterations, F &&fn)
+{
+    vector<double> samples;
+    for (size_t i = 0; i < ROUNDS; ++i) {
+        samples.push_back(fn(iterations) / (double)iterations);
+    }
+    sort(samples.begin(), samples.end());
+    results.push_back({name, n, iterations, samples[ROUNDS / 2]});
+    cerr << name << " n=" << n << ": " << samples[ROUNDS / 2] << " ns" << endl;
+}
+
+static double elapsed(bench_clock::time_point beg)
+{
+    return (double)chrono::duration_cast<chrono::nanoseconds>(bench_clock::now() - beg).count();
+}
+
+class Listener : public Object {
+public:
+
+    void proc(Slot &) {
+        sink = sink + 1;
+    }
+
+    void value(int v) {
+        sink = sink + v;
+    }
+};
+
+class Hub : public Object {
+public:
+
+    SS_SIGNALS(tock)
+
+    Hub() {
+        signals().registerr("tick");
+    }
+
+    Signal<int> changed{this};
+};
+
+// 场景中的对象，既是信号源也是监听者
+class SceneNode : public Object {
+public:
+
+    SceneNode() {
+        signals().registerr("tick");
+    }
+
+    void proc(Slot &) {
+        sink = sink + 1;
+    }
+};
+
+static size_t scaled(size_t work, size_t slots)
+{
+    return max<size_t>(16, work / (slots + 1));
+}
+
+static void benchEmit()
+{
+    for (size_t n : {0, 1, 8, 64, 1024}) {
+        Hub hub;
+        vector<unique_ptr<Listener>> listeners;
+        for (size_t i = 0; i < n; ++i) {
+            listeners.emplace_back(new Listener());
+            hub.signals().connect("tick", &Listener::proc, listeners.back().get());
+            hub.signals().connect(Hub::Sig::tock, &Listener::proc, listeners.back().get());
+            hub.changed.connect(&Listener::value, listeners.back().get());
+        }
+
+        signal_t sig = SignalNames::find("tick");
+        measure("emit", n, scaled(1 << 20, n), [&](size_t iters) {
+            auto beg = bench_clock::now();
+            for (size_t i = 0; i < iters; ++i) {
+                hub.signals().emit(sig);
+            }
+            return elapsed(beg);
+        });
+
+        // 编译期声明的信号，按照索引访问插槽
+        measure("emit_declared", n, scaled(1 << 20, n), [&](size_t iters) {
+            auto beg = bench_clock::now();
+            for (size_t i = 0; i < iters; ++i) {
+                hub.signals().emit(Hub::Sig::tock);
+            }
+            return elapsed(beg);
+        });
+
+        measure("emit_by_name", n, scaled(1 << 20, n), [&](size_t iters) {
+            auto beg = bench_clock::now();
+            for (size_t i = 0; i < iters; ++i) {
+                hub.signals().emit("tick");
+            }
+            return elapsed(beg);
+        });
+
+        // 每批64个数据，按单个数据计算耗时
+        vector<Slot::data_type> batch(64);
+        measure("emit_batch", n, scaled(1 << 20, n) / 64 * 64, [&](size_t iters) {
+            auto beg = bench_clock::now();
+            for (size_t i = 0; i < iters; i += batch.size()) {
+                hub.signals().emitBatch(sig, batch);
+            }
+            return elapsed(beg);
+        });
+
+        measure("emit_batch_slot_major", n, scaled(1 << 20, n) / 64 * 64, [&](size_t iters) {
+            auto beg = bench_clock::now();
+            for (size_t i = 0; i < iters; i += batch.size()) {
+                hub.signals().emitBatch(sig, batch, EmitOrder::SLOT_MAJOR);
+            }
+            return elapsed(beg);
+        });
+
+        measure("emit_typed", n, scaled(1 << 20, n), [&](size_t iters) {
+            auto beg = bench_clock::now();
+            for (size_t i = 0; i < iters; ++i) {
+                hub.changed.emit(1);
+            }
+            return elapsed(beg);
+        });
+    }
+
+    // 连接过但已经全部断开以及阻塞的信号，不读取插槽列表直接返回
+    Hub hub;
+    Listener listener;
+    signal_t sig = SignalNames::find("tick");
+    hub.signals().connect(sig, &Listener::proc, &listener);
+    hub.signals().disconnectOfTarget(&listener);
+    measure("emit_disconnected", 0, 1 << 20, [&](size_t iters) {
+        auto beg = bench_clock::now();
+        for (size_t i = 0; i < iters; ++i) {
+            hub.signals().emit(sig);
+        }
+        return elapsed(beg);
+    });
+
+    hub.signals().connect(sig, &Listener::proc, &listener);
+    hub.signals().block(sig);
+    measure("emit_blocked", 1, 1 << 20, [&](size_t iters) {
+        auto beg = bench_clock::now();
+        for (size_t i = 0; i < iters; ++i) {
+            hub.signals().emit(sig);
+        }
+        return elapsed(beg);
+    });
+}
+
+static void benchConnect()
+{
+    for (size_t n : {16, 256, 4096}) {
+        vector<unique_ptr<Listener>> listeners;
+        for (size_t i = 0; i < n; ++i) {
+            listeners.emplace_back(new Listener());
+        }
+
+        // 每轮连接n个插槽，单次耗时随已连接的插槽数增长
+        measure("connect", n, n, [&](size_t iters) {
+            Hub hub;
+            auto beg = bench_clock::now();
+            for (size_t i = 0; i < iters; ++i) {
+                hub.signals().connect("tick", &Listener::proc, listeners[i].get());
+            }
+            return elapsed(beg);
+        });
+
+        // 通过连接句柄断开
+        measure("disconnect_handle", n, n, [&](size_t iters) {
+            Hub hub;
+            vector<Connection> conns;
+            for (size_t i = 0; i < iters; ++i) {
+                conns.emplace_back(hub.signals().connect("tick", &Listener::proc, listeners[i].get()));
+            }
+            auto beg = bench_clock::now();
+            for (auto &conn : conns) {
+                conn.disconnect();
+            }
+            return elapsed(beg);
+        });
+
+        measure("disconnect", n, n, [&](size_t iters) {
+            Hub hub;
+            for (size_t i = 0; i < iters; ++i) {
+                hub.signals().connect("tick", &Listener::proc, listeners[i].get());
+            }
+            auto beg = bench_clock::now();
+            for (size_t i = 0; i < iters; ++i) {
+                hub.signals().disconnect("tick", (Slot::pfn_membercallback_type)&Listener::proc, listeners[i].get());
+            }
+            return elapsed(beg);
+        });
+
+        // 连接到粘性信号，每个新连接立即收到保留的状态，不需要重新查询
+        measure("connect_sticky", n, n, [&](size_t iters) {
+            Object src;
+            src.signals().registerr("state", 1);
+            src.signals().emit("state", com::_V(1));
+            auto beg = bench_clock::now();
+            for (size_t i = 0; i < iters; ++i) {
+                src.signals().connect("state", &Listener::proc, listeners[i].get());
+            }
+            return elapsed(beg);
+        });
+    }
+}
+
+static void benchOnce()
+{
+    // 反复连接一次性插槽并激发
+    Hub hub;
+    signal_t sig = SignalNames::find("tick");
+    measure("once_churn", 1, 1 << 16, [&](size_t iters) {
+        auto beg = bench_clock::now();
+        for (size_t i = 0; i < iters; ++i) {
+            hub.signals().once(sig, [&](Slot &) {
+                sink = sink + 1;
+            });
+            hub.signals().emit(sig);
+        }
+        return elapsed(beg);
+    });
+}
+
+static void benchNested()
+{
+    // 插槽中激发下一个对象的信号，形成depth层的嵌套
+    for (size_t depth : {1, 8, 64}) {
+        vector<unique_ptr<Hub>> chain;
+        for (size_t i = 0; i < depth; ++i) {
+            chain.emplace_back(new Hub());
+        }
+        signal_t sig = SignalNames::find("tick");
+        for (size_t i = 0; i + 1 < depth; ++i) {
+            Hub *next = chain[i + 1].get();
+            chain[i]->signals().connect(sig, [next, sig](Slot &) {
+                next->signals().emit(sig);
+            });
+        }
+        chain.back()->signals().connect(sig, [&](Slot &) {
+            sink = sink + 1;
+        });
+
+        measure("nested_emit", depth, scaled(1 << 18, depth), [&](size_t iters) {
+            auto beg = bench_clock::now();
+            for (size_t i = 0; i < iters; ++i) {
+                chain.front()->signals().emit(sig);
+            }
+            return elapsed(beg);
+        });
+    }
+}
+
+static void benchParallel()
+{
+    // 每个插槽执行一段计算，比较顺序执行和线程池中并行执行
+    for (size_t n : {8, 64}) {
+        Hub serial, parallel;
+        for (size_t i = 0; i < n; ++i) {
+            auto work = [](Slot &) {
+                // 局部变量，避免多个线程写同一个 sink
+                volatile size_t v = 0;
+                for (size_t k = 0; k < 4096; ++k)
+                    v = v * 31 + k;
+            };
+            serial.signals().connect("tick", work);
+            parallel.signals().connect("tick", work).concurrent();
+        }
+
+        measure("emit_serial_work", n, scaled(1 << 14, n), [&](size_t iters) {
+            auto beg = bench_clock::now();
+            for (size_t i = 0; i < iters; ++i) {
+                serial.signals().emit("tick");
+            }
+            return elapsed(beg);
+        });
+
+#if SS_THREADSAFE
+        measure("emit_parallel_work", n, scaled(1 << 14, n), [&](size_t iters) {
+            auto beg = bench_clock::now();
+            for (size_t i = 0; i < iters; ++i) {
+                parallel.signals().emit("tick");
+            }
+            return elapsed(beg);
+        });
+#endif
+    }
+
+#if !SS_THREADSAFE
+    // 单线程模式下并发插槽也是顺序执行，结果和 emit_serial_work 相同，使用 ss_bench_mt 测试
+    skipped.push_back({"emit_parallel_work", "concurrent slots run serially without SS_THREADSAFE, see ss_bench_mt"});
+#endif
+}
+
+static void benchChannel()
+{
+    // 激发写入通道，消费者线程批量读取，n为通道容量
+    for (size_t n : {64, 1024}) {
+        Hub hub;
+        Channel ch(n);
+        hub.signals().connect("tick", ch);
+        thread consumer([&]() {
+            Slot::data_type buf[64];
+            while (ch.wait(buf, 64)) {
+            }
+        });
+        auto data = com::_V(1);
+        measure("emit_channel", n, 1 << 20, [&](size_t iters) {
+            auto beg = bench_clock::now();
+            for (size_t i = 0; i < iters; ++i) {
+                hub.signals().emit("tick", data);
+            }
+            return elapsed(beg);
+        });
+        hub.signals().disconnect("tick");
+        ch.close();
+        consumer.join();
+    }
+}
+
+static void benchPayload()
+{
+    // 构造携带字符串的数据，n为字符串长度
+    for (size_t n : {8, 64}) {
+        string str(n, 'x');
+        measure("variant_string", n, 1 << 20, [&](size_t iters) {
+            auto beg = bench_clock::now();
+            for (size_t i = 0; i < iters; ++i) {
+                auto v = com::_V(str);
+                sink = sink + v->toString().size();
+            }
+            return elapsed(beg);
+        });
+    }
+
+    // 携带n字节的数据激发，复制到vector和引用外部缓冲
+    for (size_t n : {4096, 1 << 22}) {
+        Hub hub;
+        signal_t sig = SignalNames::find("tick");
+        hub.signals().connect(sig, [&](Slot &s) {
+            sink = sink + s.data->toView().size();
+        });
+        auto frame = make_shared<com::Variant<>::bytes_type>(n, 1);
+        measure("emit_bytes", n, scaled(1 << 24, n), [&](size_t iters) {
+            auto beg = bench_clock::now();
+            for (size_t i = 0; i < iters; ++i) {
+                hub.signals().emit(sig, com::_V(*frame));
+            }
+            return elapsed(beg);
+        });
+        measure("emit_buffer", n, scaled(1 << 24, n), [&](size_t iters) {
+            auto beg = bench_clock::now();
+            for (size_t i = 0; i < iters; ++i) {
+                hub.signals().emit(sig, com::_V(com::Buffer(frame)));
+            }
+            return elapsed(beg);
+        });
+    }
+}
+
+// 创建n个对象，统计平均每个对象占用的字节数
+template<typename T, typename F>
+static void footprint(string const &name, size_t n, F &&init)
+{
+    vector<unique_ptr<T>> objects;
+    objects.reserve(n);
+    allocated = 0;
+    counting = true;
+    for (size_t i = 0; i < n; ++i) {
+        objects.emplace_back(new T());
+        init(*objects.back());
+    }
+    counting = false;
+    double bytes = allocated / (double)n;
+    footprints.push_back({name, n, bytes});
+    cerr << name << " n=" << n << ": " << bytes << " bytes" << endl;
+}
+
+static void benchMemory()
+{
+    const size_t n = 1 << 16;
+
+    // 从未使用过信号的对象
+    footprint<Object>("object_idle", n, [](Object &) {});
+
+    // 注册了信号但是没有连接
+    footprint<Object>("object_registered", n, [](Object &o) {
+        o.signals().registerr("tick");
+        o.signals().registerr("tock");
+    });
+
+    // 注册了一个信号并带有类型化信号，没有连接
+    footprint<Hub>("hub_unconnected", n, [](Hub &) {});
+}
+
+static void benchTeardown()
+{
+    for (size_t n : {16, 256, 4096}) {
+        // 一个监听者连接到n个信号源，测量监听者析构
+        measure("destroy_listener", n, 1, [&](size_t) {
+            vector<unique_ptr<Hub>> hubs;
+            auto listener = new Listener();
+            for (size_t i = 0; i < n; ++i) {
+                hubs.emplace_back(new Hub());
+                hubs.back()->signals().connect("tick", &Listener::proc, listener);
+            }
+            auto beg = bench_clock::now();
+            delete listener;
+            return elapsed(beg);
+        });
+
+        // 一个信号源连接了n个监听者，测量信号源析构
+        measure("destroy_hub", n, 1, [&](size_t) {
+            vector<unique_ptr<Listener>> listeners;
+            auto hub = new Hub();
+            for (size_t i = 0; i < n; ++i) {
+                listeners.emplace_back(new Listener());
+                hub->signals().connect("tick", &Listener::proc, listeners.back().get());
+            }
+            auto beg = bench_clock::now();
+            delete hub;
+            return elapsed(beg);
+        });
+
+        // 信号源连接了n个监听者，测量全部监听者析构
+        measure("destroy_listeners", n, n, [&](size_t iters) {
+            Hub hub;
+            vector<unique_ptr<Listener>> listeners;
+            for (size_t i = 0; i < iters; ++i) {
+                listeners.emplace_back(new Listener());
+                hub.signals().connect("tick", &Listener::proc, listeners.back().get());
+            }
+            auto beg = bench_clock::now();
+            listeners.clear();
+            return elapsed(beg);
+        });
+    }
+
+    // 场景中的对象互相连接并且连接到存活的信号源，比较逐个析构和批量析构
+    for (size_t n : {256, 4096}) {
+        auto scene = [&](bool scoped, size_t iters) {
+            Hub hub;
+            vector<unique_ptr<SceneNode>> objs;
+            for (size_t i = 0; i < iters; ++i) {
+                objs.emplace_back(new SceneNode());
+                hub.signals().connect("tick", &SceneNode::proc, objs.back().get());
+                if (i) {
+                    objs[i]->signals().connect("tick", &SceneNode::proc, objs[i - 1].get());
+                    objs[i - 1]->signals().connect("tick", &SceneNode::proc, objs[i].get());
+                }
+            }
+            auto beg = bench_clock::now();
+            if (scoped) {
+                TeardownScope scope;
+                scope.doom(objs.begin(), objs.end());
+                objs.clear();
+            } else {
+                objs.clear();
+            }
+            return elapsed(beg);
+        };
+        measure("destroy_scene", n, n, [&](size_t iters) {
+            return scene(false, iters);
+        });
+        measure("destroy_scene_scoped", n, n, [&](size_t iters) {
+            return scene(true, iters);
+        });
+    }
+
+    // 一个信号源连接了10万个监听者，每个监听者析构只断开自己的连接，耗时和信号源的插槽总数无关
+    // 多线程模式下每次连接都复制插槽列表，准备阶段是平方的，减少到1万个
+    const size_t SPOKES = SS_THREADSAFE ? 10000 : 100000;
+    measure("destroy_spokes", SPOKES, SPOKES, [&](size_t iters) {
+        Hub hub;
+        vector<unique_ptr<Listener>> listeners;
+        for (size_t i = 0; i < iters; ++i) {
+            listeners.emplace_back(new Listener());
+            hub.signals().connect("tick", &Listener::proc, listeners.back().get());
+        }
+        auto beg = bench_clock::now();
+        listeners.clear();
+        return elapsed(beg);
+    });
+}
+
+static string toJson()
+{
+    ostringstream oss;
+    oss << "{\n";
+    oss << "  \"threadsafe\": " << SS_THREADSAFE << ",\n";
+    oss << "  \"rounds\": " << ROUNDS << ",\n";
+    oss << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        auto const &r = results[i];
+        oss << "    {\"name\": \"" << r.name << "\", \"n\": " << r.n
+            << ", \"iterations\": " << r.iterations << ", \"ns_per_op\": " << r.ns << "}";
+        oss << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    oss << "  ],\n";
+    oss << "  \"memory\": [\n";
+    for (size_t i = 0; i < footprints.size(); ++i) {
+        auto const &r = footprints[i];
+        oss << "    {\"name\": \"" << r.name << "\", \"n\": " << r.n
+            << ", \"bytes_per_object\": " << r.bytes << "}";
+        oss << (i + 1 < footprints.size() ? ",\n" : "\n");
+    }
+    oss << "  ],\n";
+    oss << "  \"skipped\": [\n";
+    for (size_t i = 0; i < skipped.size(); ++i) {
+        auto const &r = skipped[i];
+        oss << "    {\"name\": \"" << r.name << "\", \"reason\": \"" << r.reason << "\"}";
+        oss << (i + 1 < skipped.size() ? ",\n" : "\n");
+    }
+    oss << "  ]\n}\n";
+    return oss.str();
+}
+
+int main(int argc, char **argv)
+{
+    // 最先统计内存，避免复用其他测试释放的缓存
+    benchMemory();
+    benchEmit();
+    benchConnect();
+    benchOnce();
+    benchNested();
+    benchParallel();
+    benchChannel();
+    benchPayload();
+    benchTeardown();
+
+    auto json = toJson();
+    if (argc > 1) {
+        ofstream out(argv[1]);
+        out << json;
+    } else {
+        cout << json;
+    }
+    return 0;
+}
@@ -12,12 +12,14 @@
 #include <atomic>
 #include <string>
 #include <memory>
+#include <new>
 #include <algorithm>
 #include <functional>
 #include <initializer_list>
 #include <vector>
 #include <map>
 #include <cassert>
+#include <cstddef>
 
 COMXX_BEGIN
 
@@ -43,6 +45,67 @@ static bool operator<(IID const &l, IID const &r)
         l.d4.d2.d2 < r.d4.d2.d2;
 }
 
+// 不持有内存的字节视图
+class BytesView
+{
+public:
+
+    BytesView() = default;
+
+    BytesView(void const *data, size_t size)
+        : _data(static_cast<unsigned char const *>(data)), _size(size)
+    {}
+
+    inline unsigned char const *data() const
+    { return _data; }
+
+    inline size_t size() const
+    { return _size; }
+
+    inline bool empty() const
+    { return _size == 0; }
+
+    inline unsigned char const *begin() const
+    { return _data; }
+
+    inline unsigned char const *end() const
+    { return _data + _size; }
+
+    inline unsigned char operator[](size_t idx) const
+    { return _data[idx]; }
+
+private:
+    unsigned char const *_data = nullptr;
+    size_t _size = 0;
+};
+
+// 外部的字节缓冲，不复制数据，owner 保证内存在所有引用释放前有效
+class Buffer: public BytesView
+{
+public:
+
+    Buffer() = default;
+
+    Buffer(void const *data, size_t size, ::std::shared_ptr<void const> owner)
+        : BytesView(data, size), _owner(::std::move(owner))
+    {}
+
+    // 共享连续容器中的数据，例如 shared_ptr<vector<unsigned char> >，容器在使用期间不能修改
+    template<typename C>
+    explicit Buffer(::std::shared_ptr<C> const &bytes)
+        : BytesView(bytes->data(), bytes->size() * sizeof(*bytes->data())), _owner(bytes)
+    {}
+
+    inline ::std::shared_ptr<void const> const &owner() const
+    { return _owner; }
+
+    // 只读映射文件，失败或者平台不支持时返回空的缓冲，实现在 signals.cpp 中，不把平台的头文件带入公共头文件
+    static Buffer map(::std::string const &path);
+
+private:
+    ::std::shared_ptr<void const> _owner;
+};
+
 template<typename TObject = class IObject,
     typename TString = ::std::string,
     typename TBytes = ::std::vector<unsigned char>
@@ -87,6 +150,7 @@ public:
         OBJECT = 16,
         BOOLEAN = 17,
         POINTER = 18,
+        BUFFER = 19,
     };
 
     Variant();
@@ -125,19 +189,32 @@ public:
 
     Variant(bytes_type const &);
 
+    Variant(bytes_type &&);
+
     Variant(::std::string const &);
 
+    Variant(::std::string &&);
+
     Variant(char const *);
 
+    // 引用外部的缓冲，不复制数据
+    Variant(Buffer const &);
+
+    Variant(Buffer &&);
+
     Variant(func_type);
 
     Variant(Variant const &);
 
+    Variant(Variant &&) noexcept;
+
     Variant(::std::shared_ptr<Variant> const &);
 
     ~Variant();
 
-    const VT vt;
+    // 当前保存的类型
+    inline VT type() const
+    { return _vt; }
 
     object_type *toObject() const;
 
@@ -169,16 +246,36 @@ public:
 
     bool toBool() const;
 
+    // 只用于 BYTES，其他类型返回空，通用的字节访问使用 toView()
     bytes_type const &toBytes() const;
 
+    // 只用于 STRING，其他类型返回空
     ::std::string const &toString() const;
 
+    // 只用于 BUFFER，其他类型返回空
+    Buffer const &toBuffer() const;
+
+    // BYTES、STRING、BUFFER 的数据视图，不复制数据，其他类型返回空
+    BytesView toView() const;
+
     func_type toFunction() const;
 
     Variant &operator=(Variant const &);
 
+    Variant &operator=(Variant &&) noexcept;
+
 private:
-    union
+
+    // 联合体的判别值，只能由构造、赋值和 _reset 修改
+    VT _vt;
+
+    // 释放当前的数据
+    void _reset();
+
+    // 接管 r 的数据，调用前当前对象不持有任何数据
+    void _take(Variant &&r);
+
+    union pod_type
     {
         object_type *o;
         void *p;
@@ -196,10 +293,16 @@ private:
         unsigned char uc;
         bool b;
         func_type fn;
-    } _pod;
+    };
 
-    ::std::shared_ptr<bytes_type> _bytes;
-    ::std::shared_ptr<string_type> _str;
+    // 字符串和字节直接保存在对象内，短字符串使用 string_type 自身的短字符串优化，不需要申请内存
+    union
+    {
+        pod_type _pod;
+        string_type _str;
+        bytes_type _bytes;
+        Buffer _buf;
+    };
 };
 
 template<typename V>
@@ -374,7 +477,7 @@ inline bool drop<IObject *>(IObject *v)
 
 template<typename Types>
 inline Variant<Types>::Variant(object_type *v)
-    : vt(VT::OBJECT)
+    : _vt(VT::OBJECT)
 {
     _pod.o = v;
     if (_pod.o) {
@@ -384,134 +487,208 @@ inline Variant<Types>::Variant(object_type *v)
 
 template<typename Types>
 inline Variant<Types>::Variant()
-    : vt(VT::NIL)
+    : _vt(VT::NIL)
 {}
 
 template<typename Types>
 inline Variant<Types>::Variant(void *v)
-    : vt(VT::POINTER)
+    : _vt(VT::POINTER)
 { _pod.p = v; }
 
 template<typename Types>
 inline Variant<Types>::Variant(::std::nullptr_t)
-    : vt(VT::POINTER)
+    : _vt(VT::POINTER)
 { _pod.p = nullptr; }
 
 template<typename Types>
 inline Variant<Types>::Variant(int v)
-    : vt(VT::INT)
+    : _vt(VT::INT)
 { _pod.i = v; }
 
 template<typename Types>
 inline Variant<Types>::Variant(unsigned int v)
-    : vt(VT::UINT)
+    : _vt(VT::UINT)
 { _pod.ui = v; }
 
 template<typename Types>
 inline Variant<Types>::Variant(long v)
-    : vt(VT::LONG)
+    : _vt(VT::LONG)
 { _pod.l = v; }
 
 template<typename Types>
 inline Variant<Types>::Variant(unsigned long v)
-    : vt(VT::ULONG)
+    : _vt(VT::ULONG)
 { _pod.ul = v; }
 
 template<typename Types>
 inline Variant<Types>::Variant(short v)
-    : vt(VT::SHORT)
+    : _vt(VT::SHORT)
 { _pod.s = v; }
 
 template<typename Types>
 inline Variant<Types>::Variant(unsigned short v)
-    : vt(VT::USHORT)
+    : _vt(VT::USHORT)
 { _pod.us = v; }
 
 template<typename Types>
 inline Variant<Types>::Variant(long long v)
-    : vt(VT::LONGLONG)
+    : _vt(VT::LONGLONG)
 { _pod.ll = v; }
 
 template<typename Types>
 inline Variant<Types>::Variant(unsigned long long v)
-    : vt(VT::ULONGLONG)
+    : _vt(VT::ULONGLONG)
 { _pod.ull = v; }
 
 template<typename Types>
 inline Variant<Types>::Variant(float v)
-    : vt(VT::FLOAT)
+    : _vt(VT::FLOAT)
 { _pod.f = v; }
 
 template<typename Types>
 inline Variant<Types>::Variant(double v)
-    : vt(VT::DOUBLE)
+    : _vt(VT::DOUBLE)
 { _pod.d = v; }
 
 template<typename Types>
 inline Variant<Types>::Variant(char v)
-    : vt(VT::CHAR)
+    : _vt(VT::CHAR)
 { _pod.c = v; }
 
 template<typename Types>
 inline Variant<Types>::Variant(unsigned char v)
-    : vt(VT::UCHAR)
+    : _vt(VT::UCHAR)
 { _pod.uc = v; }
 
 template<typename Types>
 inline Variant<Types>::Variant(bool v)
-    : vt(VT::BOOLEAN)
+    : _vt(VT::BOOLEAN)
 { _pod.b = v; }
 
 template<typename Types>
 inline Variant<Types>::Variant(bytes_type const &v)
-    : vt(VT::BYTES)
-{ _bytes = ::std::make_shared<bytes_type>(v); }
+    : _vt(VT::BYTES)
+{ new (&_bytes) bytes_type(v); }
+
+template<typename Types>
+inline Variant<Types>::Variant(bytes_type &&v)
+    : _vt(VT::BYTES)
+{ new (&_bytes) bytes_type(::std::move(v)); }
 
 template<typename Types>
 inline Variant<Types>::Variant(::std::string const &v)
-    : vt(VT::STRING)
-{ _str = ::std::make_shared<string_type>(v); }
+    : _vt(VT::STRING)
+{ new (&_str) string_type(v); }
+
+template<typename Types>
+inline Variant<Types>::Variant(::std::string &&v)
+    : _vt(VT::STRING)
+{ new (&_str) string_type(::std::move(v)); }
 
 template<typename Types>
 inline Variant<Types>::Variant(char const *v)
-    : vt(VT::STRING)
-{ _str = ::std::make_shared<string_type>(v); }
+    : _vt(VT::STRING)
+{ new (&_str) string_type(v); }
+
+template<typename Types>
+inline Variant<Types>::Variant(Buffer const &v)
+    : _vt(VT::BUFFER)
+{ new (&_buf) Buffer(v); }
+
+template<typename Types>
+inline Variant<Types>::Variant(Buffer &&v)
+    : _vt(VT::BUFFER)
+{ new (&_buf) Buffer(::std::move(v)); }
 
 template<typename Types>
 inline Variant<Types>::Variant(func_type v)
-    : vt(VT::FUNCTION)
+    : _vt(VT::FUNCTION)
 { _pod.fn = v; }
 
 template<typename Types>
 inline Variant<Types>::Variant(Variant const &r)
-    : vt(r.vt)
+    : _vt(r._vt)
 {
-    _pod = r._pod;
-    _bytes = r._bytes;
-    _str = r._str;
-    if (r.vt == VT::OBJECT && _pod.o) {
-        _pod.o = grab(_pod.o);
+    switch (_vt) {
+    case VT::STRING:
+        new (&_str) string_type(r._str);
+        break;
+    case VT::BYTES:
+        new (&_bytes) bytes_type(r._bytes);
+        break;
+    case VT::BUFFER:
+        new (&_buf) Buffer(r._buf);
+        break;
+    default:
+        _pod = r._pod;
+        if (_vt == VT::OBJECT && _pod.o) {
+            _pod.o = grab(_pod.o);
+        }
+        break;
     }
 }
 
+template<typename Types>
+inline Variant<Types>::Variant(Variant &&r) noexcept
+    : _vt(VT::NIL)
+{
+    _take(::std::move(r));
+}
+
 template<typename Types>
 inline Variant<Types>::Variant(::std::shared_ptr<Variant> const &r)
-    : vt(r->vt)
+    : Variant(*r)
+{}
+
+template<typename Types>
+inline Variant<Types>::~Variant()
 {
-    _pod = r->_pod;
-    _bytes = r->_bytes;
-    _str = r->_str;
-    if (r->vt == VT::OBJECT && _pod.o) {
-        _pod.o = grab(_pod.o);
+    _reset();
+}
+
+template<typename Types>
+inline void Variant<Types>::_reset()
+{
+    switch (_vt) {
+    case VT::STRING:
+        _str.~string_type();
+        break;
+    case VT::BYTES:
+        _bytes.~bytes_type();
+        break;
+    case VT::BUFFER:
+        _buf.~Buffer();
+        break;
+    case VT::OBJECT:
+        if (_pod.o)
+            drop(_pod.o);
+        break;
+    default:
+        break;
     }
+    _vt = VT::NIL;
 }
 
 template<typename Types>
-inline Variant<Types>::~Variant()
+inline void Variant<Types>::_take(Variant &&r)
 {
-    if (vt == VT::OBJECT && _pod.o) {
-        drop(_pod.o);
-        _pod.o = nullptr;
+    _vt = r._vt;
+    switch (_vt) {
+    case VT::STRING:
+        new (&_str) string_type(::std::move(r._str));
+        break;
+    case VT::BYTES:
+        new (&_bytes) bytes_type(::std::move(r._bytes));
+        break;
+    case VT::BUFFER:
+        new (&_buf) Buffer(::std::move(r._buf));
+        break;
+    default:
+        // 对象的引用直接转移
+        _pod = r._pod;
+        if (_vt == VT::OBJECT)
+            r._pod.o = nullptr;
+        break;
     }
 }
 
@@ -679,11 +856,49 @@ inline bool Variant<Types>::toBool() const
 
 template<typename Types>
 inline typename Variant<Types>::bytes_type const &Variant<Types>::toBytes() const
-{ return *_bytes; }
+{
+    // 联合体中只有当前类型的成员有效
+    if (_vt != VT::BYTES) {
+        static bytes_type const empty;
+        return empty;
+    }
+    return _bytes;
+}
 
 template<typename Types>
 inline ::std::string const &Variant<Types>::toString() const
-{ return *_str; }
+{
+    if (_vt != VT::STRING) {
+        static ::std::string const empty;
+        return empty;
+    }
+    return _str;
+}
+
+template<typename Types>
+inline Buffer const &Variant<Types>::toBuffer() const
+{
+    if (_vt != VT::BUFFER) {
+        static Buffer const empty;
+        return empty;
+    }
+    return _buf;
+}
+
+template<typename Types>
+inline BytesView Variant<Types>::toView() const
+{
+    switch (_vt) {
+    case VT::BYTES:
+        return BytesView(_bytes.data(), _bytes.size() * sizeof(*_bytes.data()));
+    case VT::STRING:
+        return BytesView(_str.data(), _str.size() * sizeof(*_str.data()));
+    case VT::BUFFER:
+        return _buf;
+    default:
+        return BytesView();
+    }
+}
 
 template<typename Types>
 inline typename Variant<Types>::func_type Variant<Types>::toFunction() const
@@ -693,21 +908,20 @@ template<typename Types>
 inline Variant<Types> &Variant<Types>::operator=(Variant const &r)
 {
     if (this != &r) {
-        _bytes = r._bytes;
-        _str = r._str;
+        // 先复制再释放，r 可能被当前的数据持有
+        Variant tmp(r);
+        _reset();
+        _take(::std::move(tmp));
+    }
+    return *this;
+}
 
-        object_type *old = nullptr;
-        if (vt == VT::OBJECT && _pod.o) {
-            old = _pod.o;
-        }
-        const_cast<VT &>(vt) = r.vt;
-        _pod = r._pod;
-        if (vt == VT::OBJECT && _pod.o) {
-            _pod.o = grab(_pod.o);
-        }
-        if (old) {
-            drop(old);
-        }
+template<typename Types>
+inline Variant<Types> &Variant<Types>::operator=(Variant &&r) noexcept
+{
+    if (this != &r) {
+        _reset();
+        _take(::std::move(r));
     }
     return *this;
 }
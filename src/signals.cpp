@@ -2,17 +2,467 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <deque>
 #include <future>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 #include <utility>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define COMXX_MMAP 1
+#else
+#define COMXX_MMAP 0
+#endif
+
 SS_BEGIN
 
-// 获得当前时间
+// 获得当前时间(秒)，使用单调时钟，不受系统时间调整的影响
 static double TimeCurrent() {
-    auto now = ::std::chrono::system_clock::now().time_since_epoch();
+    auto now = ::std::chrono::steady_clock::now().time_since_epoch();
     return ::std::chrono::duration_cast<::std::chrono::microseconds>(now).count() / 1000000.;
 }
 
+#if SS_THREADSAFE
+
+// ------------------------------------- epoch
+
+// 每个线程一个记录，保存进入临界区时的全局epoch
+struct EpochRecord {
+    // 0 表示不在临界区中
+    ::std::atomic<uint64_t> epoch{0};
+    ::std::atomic<bool> used{false};
+    EpochRecord *next = nullptr;
+
+    // 嵌套深度，只会被所属线程访问
+    unsigned depth = 0;
+};
+
+struct EpochRetired {
+    uint64_t epoch;
+    void *ptr;
+    void (*deleter)(void *);
+};
+
+struct EpochStorage {
+    ::std::atomic<uint64_t> global{1};
+    ::std::atomic<EpochRecord *> records{nullptr};
+    ::std::mutex mtx;
+    ::std::vector<EpochRetired> retired;
+};
+
+static EpochStorage &EpochInstance() {
+    // 不析构，避免静态对象析构时依旧需要回收
+    static EpochStorage *storage = new EpochStorage();
+    return *storage;
+}
+
+// 线程退出时归还记录，供新的线程复用
+struct EpochLocal {
+    EpochRecord *rec = nullptr;
+
+    ~EpochLocal() {
+        if (rec) {
+            rec->depth = 0;
+            rec->epoch.store(0);
+            rec->used.store(false);
+        }
+    }
+};
+
+static EpochRecord *EpochCurrent() {
+    thread_local EpochLocal local;
+    if (local.rec)
+        return local.rec;
+
+    auto &storage = EpochInstance();
+    for (auto r = storage.records.load(); r; r = r->next) {
+        bool expected = false;
+        if (!r->used.load() && r->used.compare_exchange_strong(expected, true)) {
+            local.rec = r;
+            return r;
+        }
+    }
+
+    auto r = new EpochRecord();
+    r->used.store(true);
+    auto head = storage.records.load();
+    do {
+        r->next = head;
+    } while (!storage.records.compare_exchange_weak(head, r));
+    local.rec = r;
+    return r;
+}
+
+Epoch::Guard::Guard() {
+    auto rec = EpochCurrent();
+    if (rec->depth++ == 0) {
+        rec->epoch.store(EpochInstance().global.load());
+    }
+}
+
+Epoch::Guard::Guard(Guard const &)
+    : Guard()
+{
+    // pass
+}
+
+Epoch::Guard::~Guard() {
+    auto rec = EpochCurrent();
+    if (--rec->depth == 0) {
+        rec->epoch.store(0);
+    }
+}
+
+void Epoch::retire(void *p, void (*deleter)(void *)) {
+    auto &storage = EpochInstance();
+    ::std::vector<EpochRetired> frees;
+    {
+        ::std::lock_guard<::std::mutex> lck(storage.mtx);
+        storage.retired.push_back({storage.global.fetch_add(1), p, deleter});
+
+        // 在最早的活跃读取方进入之前回收的对象都可以释放
+        uint64_t earliest = UINT64_MAX;
+        for (auto r = storage.records.load(); r; r = r->next) {
+            auto e = r->epoch.load();
+            if (e && e < earliest)
+                earliest = e;
+        }
+
+        auto &retired = storage.retired;
+        auto iter = ::std::partition(retired.begin(), retired.end(), [=](EpochRetired const &e) {
+            return e.epoch >= earliest;
+        });
+        frees.assign(iter, retired.end());
+        retired.erase(iter, retired.end());
+    }
+
+    // 在锁外释放，析构过程中可能会再次回收
+    for (auto &e : frees) {
+        e.deleter(e.ptr);
+    }
+}
+
+void Epoch::synchronize() {
+    auto &storage = EpochInstance();
+    auto target = storage.global.fetch_add(1);
+    auto self = EpochCurrent();
+    for (auto r = storage.records.load(); r; r = r->next) {
+        if (r == self)
+            continue;
+        for (;;) {
+            auto e = r->epoch.load();
+            if (e == 0 || e > target)
+                break;
+            ::std::this_thread::yield();
+        }
+    }
+}
+
+#endif
+
+// ------------------------------------- signal names
+
+// 名称保存在deque中保证地址稳定，索引直接引用名称的内存，查找时不需要构造string
+// 名称只增加不删除，查找使用开放寻址的索引，不加锁，分配新的id和按照id取名称时才加锁
+struct SignalNamesStorage {
+    struct Entry {
+        ::std::string name;
+        signal_t id;
+    };
+
+    // 线性探测的索引，槽位只会从null变为有效的条目，扩容时复制一份新的再原子地发布
+    struct Index {
+        explicit Index(size_t capacity)
+            : mask(capacity - 1), slots(new ::std::atomic<Entry const *>[capacity]) {
+            for (size_t i = 0; i < capacity; ++i) {
+                slots[i].store(nullptr, ::std::memory_order_relaxed);
+            }
+        }
+
+        Entry const *find(::std::string_view name) const {
+            for (size_t i = ::std::hash<::std::string_view>()(name) & mask;; i = (i + 1) & mask) {
+                auto e = slots[i].load(::std::memory_order_acquire);
+                if (!e || e->name == name)
+                    return e;
+            }
+        }
+
+        void insert(Entry const *e) {
+            size_t i = ::std::hash<::std::string_view>()(e->name) & mask;
+            while (slots[i].load(::std::memory_order_relaxed)) {
+                i = (i + 1) & mask;
+            }
+            slots[i].store(e, ::std::memory_order_release);
+        }
+
+        size_t mask;
+        ::std::unique_ptr<::std::atomic<Entry const *>[]> slots;
+    };
+
+    ::std::shared_mutex mtx;
+    ::std::deque<Entry> entries;
+
+    // 当前发布的索引，被替换的索引可能还有线程在读取，保留到进程退出
+    ::std::atomic<Index const *> index{nullptr};
+    ::std::vector<::std::unique_ptr<Index> > indexes;
+
+    SignalNamesStorage() {
+        // 0 保留为空信号
+        _add(::std::string_view());
+    }
+
+    Entry const *find(::std::string_view name) const {
+        return index.load(::std::memory_order_acquire)->find(name);
+    }
+
+    // 添加新的名称 @note 需要持有写锁
+    signal_t _add(::std::string_view name) {
+        auto sig = (signal_t)entries.size();
+        entries.push_back(Entry{::std::string(name), sig});
+
+        // 负载超过一半时扩容，新的索引填充完成后再发布
+        if (indexes.empty() || entries.size() * 2 > indexes.back()->mask + 1) {
+            size_t capacity = indexes.empty() ? 64 : (indexes.back()->mask + 1) * 2;
+            indexes.emplace_back(new Index(capacity));
+            for (auto &e : entries) {
+                indexes.back()->insert(&e);
+            }
+            index.store(indexes.back().get(), ::std::memory_order_release);
+        } else {
+            indexes.back()->insert(&entries.back());
+        }
+        return sig;
+    }
+};
+
+static SignalNamesStorage &SignalNamesInstance() {
+    static SignalNamesStorage tbl;
+    return tbl;
+}
+
+signal_t SignalNames::intern(::std::string_view name) {
+    auto &tbl = SignalNamesInstance();
+    if (auto e = tbl.find(name))
+        return e->id;
+
+    ::std::unique_lock<::std::shared_mutex> lck(tbl.mtx);
+    if (auto e = tbl.find(name))
+        return e->id;
+    return tbl._add(name);
+}
+
+signal_t SignalNames::find(::std::string_view name) {
+    auto e = SignalNamesInstance().find(name);
+    return e ? e->id : 0;
+}
+
+::std::string const &SignalNames::name(signal_t sig) {
+    auto &tbl = SignalNamesInstance();
+    ::std::shared_lock<::std::shared_mutex> lck(tbl.mtx);
+    return sig < tbl.entries.size() ? tbl.entries[sig].name : tbl.entries.front().name;
+}
+
+size_t SignalNames::size() {
+    auto &tbl = SignalNamesInstance();
+    ::std::shared_lock<::std::shared_mutex> lck(tbl.mtx);
+    return tbl.entries.size();
+}
+
+signal_t SignalClass::id(unsigned idx) const {
+    ::std::call_once(_once, [this]() {
+        for (unsigned i = 0; i < _size; ++i) {
+            _ids[i] = SignalNames::intern(_names[i]);
+        }
+    });
+    return _ids[idx];
+}
+
+unsigned SignalClass::index(signal_t sig) const {
+    if (_size == 0 || sig == 0)
+        return _size;
+    id(0);
+    for (unsigned i = 0; i < _size; ++i) {
+        if (_ids[i] == sig)
+            return i;
+    }
+    return _size;
+}
+
+::std::string_view SignalKey::name() const {
+    return _name.empty() ? ::std::string_view(SignalNames::name(id)) : _name;
+}
+
+// ------------------------------------- allocator
+
+// 按 POOL_GRANULE 分级，超过 POOL_CLASSES 级的对象直接使用全局分配
+static const size_t POOL_GRANULE = 16;
+static const size_t POOL_CLASSES = 32;
+
+// 每一级最多缓存的空闲块
+static const size_t POOL_MAXFREE = 1024;
+
+struct PoolBlock {
+    PoolBlock *next;
+};
+
+struct PoolCache {
+    PoolBlock *heads[POOL_CLASSES] = {};
+    size_t counts[POOL_CLASSES] = {};
+
+    ~PoolCache();
+};
+
+// 线程退出时缓存已经析构，之后在该线程释放的块直接归还全局
+static thread_local bool PoolCacheDead = false;
+
+PoolCache::~PoolCache() {
+    PoolCacheDead = true;
+    for (auto &head : heads) {
+        while (head) {
+            auto b = head;
+            head = b->next;
+            ::operator delete(b);
+        }
+    }
+}
+
+static PoolCache *PoolCacheCurrent() {
+    if (PoolCacheDead)
+        return nullptr;
+    thread_local PoolCache cache;
+    return &cache;
+}
+
+static thread_local Allocator *AllocatorCurrent = nullptr;
+
+Allocator &Allocator::current() {
+    return AllocatorCurrent ? *AllocatorCurrent : PoolAllocator::instance();
+}
+
+PoolAllocator &PoolAllocator::instance() {
+    // 不析构，静态对象析构时依旧可能释放插槽
+    static PoolAllocator *pool = new PoolAllocator();
+    return *pool;
+}
+
+void *PoolAllocator::allocate(size_t size) {
+    size_t cls = size ? (size - 1) / POOL_GRANULE : 0;
+    if (cls >= POOL_CLASSES)
+        return ::operator new(size);
+    auto cache = PoolCacheCurrent();
+    if (cache && cache->heads[cls]) {
+        auto b = cache->heads[cls];
+        cache->heads[cls] = b->next;
+        --cache->counts[cls];
+        return b;
+    }
+    return ::operator new((cls + 1) * POOL_GRANULE);
+}
+
+void PoolAllocator::deallocate(void *p, size_t size) {
+    size_t cls = size ? (size - 1) / POOL_GRANULE : 0;
+    auto cache = cls < POOL_CLASSES ? PoolCacheCurrent() : nullptr;
+    if (!cache || cache->counts[cls] >= POOL_MAXFREE) {
+        ::operator delete(p);
+        return;
+    }
+    auto b = static_cast<PoolBlock *>(p);
+    b->next = cache->heads[cls];
+    cache->heads[cls] = b;
+    ++cache->counts[cls];
+}
+
+// arena 的内存由独立的状态持有，arena 析构后依旧可以释放存活的对象
+struct ArenaAllocator::State : Allocator {
+    mutex_type mtx;
+    size_t chunk = 0;
+    ::std::vector<char *> chunks;
+    char *cur = nullptr;
+    size_t left = 0;
+
+    // 存活的对象数
+    size_t live = 0;
+
+    // arena 已经析构，等待存活的对象释放
+    bool orphaned = false;
+
+    virtual ~State() {
+        for (auto c : chunks)
+            ::operator delete(c);
+    }
+
+    virtual void *allocate(size_t size) override {
+        const size_t align = alignof(::std::max_align_t);
+        size = (size + align - 1) / align * align;
+
+        lock_type lck(mtx);
+        if (size > left) {
+            auto sz = ::std::max(size, chunk);
+            cur = static_cast<char *>(::operator new(sz));
+            chunks.emplace_back(cur);
+            left = sz;
+        }
+        auto p = cur;
+        cur += size;
+        left -= size;
+        ++live;
+        return p;
+    }
+
+    virtual void deallocate(void *, size_t) override {
+        bool release;
+        {
+            lock_type lck(mtx);
+            release = --live == 0 && orphaned;
+        }
+        if (release)
+            delete this;
+    }
+};
+
+ArenaAllocator::ArenaAllocator(size_t chunk)
+        : _state(new State()) {
+    _state->chunk = chunk;
+}
+
+ArenaAllocator::~ArenaAllocator() {
+    bool release;
+    {
+        lock_type lck(_state->mtx);
+        _state->orphaned = true;
+        release = _state->live == 0;
+    }
+    if (release)
+        delete _state;
+}
+
+void *ArenaAllocator::allocate(size_t size) {
+    return _state->allocate(size);
+}
+
+void ArenaAllocator::deallocate(void *p, size_t size) {
+    _state->deallocate(p, size);
+}
+
+Allocator &ArenaAllocator::backing() {
+    return *_state;
+}
+
+AllocatorScope::AllocatorScope(Allocator &alloc)
+        : _prev(AllocatorCurrent) {
+    AllocatorCurrent = &alloc;
+}
+
+AllocatorScope::~AllocatorScope() {
+    AllocatorCurrent = _prev;
+}
+
 // ------------------------------------- slot
 
 Slot::Slot()
@@ -20,501 +470,2170 @@ Slot::Slot()
     // pass
 }
 
+// 节流的尾部调用以及防抖等待中的数据
+struct Slot::Timing {
+    mutex_type mtx;
+    data_type data;
+    tunnel_type tunnel;
+
+    // 等待中的定时任务
+    TimerWheel::timer_id id = 0;
+
+    // 每次重新安排或者取消时增加，过期的定时任务不再调用
+    uint64_t seq = 0;
+};
+
 Slot::~Slot()
+{
+    delete _tm;
+}
+
+Slot::Timing *Slot::_timing() {
+    Timing *tm = _tm;
+    if (tm)
+        return tm;
+    tm = new Timing();
+#if SS_THREADSAFE
+    Timing *expected = nullptr;
+    if (!_tm.compare_exchange_strong(expected, tm)) {
+        delete tm;
+        return expected;
+    }
+#else
+    _tm = tm;
+#endif
+    return tm;
+}
+
+bool Slot::getVeto() const {
+    return _veto;
+}
+
+void Slot::setVeto(bool b) {
+    _veto = b;
+    if (tunnel)
+        tunnel->veto = b;
+    if (context)
+        context->_veto = b;
+}
+
+void Slot::setResult(::COMXX_NS::Variant<> const &v) {
+    if (!context || !context->_combiner)
+        return;
+    if (!context->_combiner->combine(v))
+        setVeto(true);
+}
+
+bool Slot::_throttle(double now) {
+    if (!eps)
+        return false;
+
+    // 窗口内的激发不会重置时间，快速多次激发时依旧可以按照频率命中，而不是全部都忽略掉
+    if (_epstm != 0 && now - _epstm < 1. / eps)
+        return true;
+    _epstm = now; //命中一次后重置时间
+    return false;
+}
+
+void Slot::emit(Slot::data_type d, Slot::tunnel_type t) {
+    if (_throttle(TimeCurrent()))
+        return;
+
+    this->data = ::std::move(d);
+    this->tunnel = ::std::move(t);
+
+    _doEmit();
+}
+
+void Slot::_doEmit() {
+    // 函数指针和成员函数由 Delegate 直接调用
+    cb(*this);
+
+    // 清理
+    data = nullptr;
+    tunnel = nullptr;
+    context = nullptr;
+
+    // 增加计数
+    ++emitedCount;
+}
+
+bool Slot::_isconnected() const {
+    return _connected && !(count && emitedCount >= count);
+}
+
+bool Slot::_claim(size_t &idx) {
+    // 先占用激发次数，避免多个线程同时激发超过设置的次数
+    idx = emitedCount++;
+    return !count || idx < count;
+}
+
+#if SS_THREADSAFE
+
+bool Slot::_emitConcurrent(Slot &ctx, signal_t sig, Object *sndr, data_type const &d, tunnel_type const &t, EmitContext *ectx) {
+    size_t idx;
+    if (!_claim(idx))
+        return false;
+
+    ctx.target = target;
+    ctx.sender = sndr;
+    ctx.signal = sig;
+    ctx.payload = payload;
+    ctx.eps = eps;
+    ctx.count = count.load();
+    ctx.emitedCount = idx + 1;
+    ctx.data = d;
+    ctx.tunnel = t;
+    ctx.context = ectx;
+    cb(ctx);
+    return true;
+}
+
+#endif
+
+// --------------------------------------- slots
+
+// 环形缓冲，写满后覆盖最早的数据
+struct Slots::Replay {
+    mutex_type mtx;
+    ::std::vector<Slot::data_type> ring;
+    size_t head = 0;
+    size_t count = 0;
+
+    explicit Replay(size_t n) : ring(n) {}
+
+    void push(Slot::data_type const &d) {
+        ring[head] = d;
+        head = (head + 1) % ring.size();
+        if (count < ring.size())
+            ++count;
+    }
+
+    // 按照激发的顺序复制
+    void copy(::std::vector<Slot::data_type> &out) const {
+        out.reserve(count);
+        size_t beg = (head + ring.size() - count) % ring.size();
+        for (size_t i = 0; i < count; ++i) {
+            out.emplace_back(ring[(beg + i) % ring.size()]);
+        }
+    }
+};
+
+Slots::Slots()
 {
     // pass
 }
 
-bool Slot::getVeto() const {
-    return _veto;
+Slots::~Slots() {
+    // 多线程模式下可能在回收时才析构，此时所属的signals可能已经释放，不能加锁
+    _slots.reset();
+}
+
+void Slots::clear() {
+    lock_type lck(_signals->_mtx);
+    {
+        auto snaps = _slots.read();
+        if (snaps) {
+            for (auto &s : *snaps) {
+                if (!s->_connected)
+                    continue;
+                s->_connected = false;
+                _signals->_untrack(s->target, s.get());
+            }
+        }
+    }
+    _slots.reset();
+    _dead = 0;
+    _live = 0;
+}
+
+void Slots::block() {
+    ++_blk;
+}
+
+void Slots::unblock() {
+    --_blk;
+}
+
+bool Slots::isblocked() const {
+    return _blk != 0;
+}
+
+void Slots::add(Slots::slot_type s) {
+    lock_type lck(_signals->_mtx);
+    s->_owner = _signals->shared_from_this();
+    s->_holder = this;
+    s->_connected = true;
+    ++_live;
+    _slots.write([&](slots_type &ss) {
+        // 按照优先级从高到低排列，插入到同一优先级的末尾，激发时直接顺序遍历
+        if (ss.empty() || ss.back()->priority >= s->priority) {
+            ss.emplace_back(::std::move(s));
+        } else {
+            auto pos = ::std::upper_bound(ss.begin(), ss.end(), s->priority, [](int priority, slot_type const &r) {
+                return priority > r->priority;
+            });
+            ss.emplace(pos, ::std::move(s));
+        }
+    });
+}
+
+template<typename P>
+Slots::removed_type Slots::_erase(P &&pred) {
+    removed_type r;
+    auto removed = [&](slot_type const &s) {
+        if (!s->_connected)
+            return true;
+        if (!pred(s))
+            return false;
+        if (s->target)
+            r.insert(s->target);
+        s->_connected = false;
+        --_live;
+        _signals->_untrack(s->target, s.get());
+        return true;
+    };
+
+    // 先清零再发布新的列表，并发读取的size()最多多算已经断开的插槽
+    _dead = 0;
+    _slots.write([&](slots_type &ss) {
+        ss.erase(::std::remove_if(ss.begin(), ss.end(), removed), ss.end());
+    });
+    return r;
+}
+
+bool Slots::_remove(Slot &s) {
+    if (!s._connected)
+        return false;
+
+    // 标记为断开，emit会跳过，断开的插槽累计超过一半时再重建列表，使断开的均摊开销为O(1)
+    s._connected = false;
+    s._dropped = true;
+    --_live;
+    _signals->_untrack(s.target, &s);
+
+    // 批量析构中只标记，作用域结束时统一压缩
+    if (TeardownScope::_defer(*_signals)) {
+        ++_dead;
+        return true;
+    }
+
+    // 重建列表后s可能已经释放
+    bool compact;
+    {
+        auto snaps = _slots.read();
+        compact = snaps && ++_dead * 2 > snaps->size();
+    }
+    if (compact) {
+        _erase([](slot_type const &) {
+            return false;
+        });
+    }
+    return true;
+}
+
+Slots::removed_type Slots::_compact() {
+    removed_type r;
+    auto expired = [](slot_type const &s) {
+        return s->count && s->emitedCount >= s->count;
+    };
+
+    lock_type lck(_signals->_mtx);
+    {
+        auto snaps = _slots.read();
+        if (!snaps || ::std::none_of(snaps->begin(), snaps->end(), expired))
+            return r;
+    }
+
+    // 移除时已经从索引中移除，不再连接的对象会断开反向连接
+    return _erase(expired);
+}
+
+bool Slots::_emitOne(slot_type const &s, Slot::data_type const &d, Slot::tunnel_type const &t, EmitContext *ctx, double &now, bool &expired) {
+    if (s->_dropped || s->_blocked)
+        return false; // 已经断开或者阻塞
+
+    if (s->count && (s->emitedCount >= s->count))
+        return false; // 已经达到设置激活的数量
+
+    if (s->eps || ((s->debounce || s->delay) && s->timer)) {
+        // 同一次激发只读取一次时钟
+        if (now == 0)
+            now = TimeCurrent();
+        if (!_timed(s, d, t, now))
+            return false;
+    }
+
+    return _invoke(s, d, t, ctx, expired);
+}
+
+bool Slots::_emitParallel(ThreadPool &pool, slot_type const *slots, size_t n, Slot::data_type const &d, Slot::tunnel_type const &t, bool &expired) {
+#if SS_THREADSAFE
+    ::std::atomic<bool> veto{false};
+    ::std::atomic<bool> exhausted{false};
+    pool.parallel(n, [&](size_t idx) {
+        // 每个任务单独读取时钟
+        double now = 0;
+        bool e = false;
+        if (_emitOne(slots[idx], d, t, nullptr, now, e))
+            veto = true;
+        if (e)
+            exhausted = true;
+    });
+    if (exhausted)
+        expired = true;
+    return veto;
+#else
+    // 插槽不是线程安全的，顺序执行，中断同样在整组执行完之后生效
+    (void)pool;
+    bool veto = false;
+    double now = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (_emitOne(slots[i], d, t, nullptr, now, expired))
+            veto = true;
+    }
+    return veto;
+#endif
+}
+
+bool Slots::_invoke(slot_type const &s, Slot::data_type const &d, Slot::tunnel_type const &t, EmitContext *ctx, bool &expired) {
+    if (s->count && (s->emitedCount >= s->count))
+        return false;
+
+    // 激发信号
+    bool veto = false;
+    if (s->dispatcher) {
+        // 队列连接，只占用激发次数，插槽在dispatcher的线程中执行
+        size_t idx;
+        if (!s->_claim(idx))
+            return false;
+        s->dispatcher->_post(s, signal, owner, d, t);
+    } else {
+#if SS_THREADSAFE
+        Slot sctx;
+        if (!s->_emitConcurrent(sctx, signal, owner, d, t, ctx))
+            return false;
+        veto = sctx.getVeto();
+#else
+        s->signal = signal;
+        s->sender = owner;
+        s->_veto = false;
+        s->data = d;
+        s->tunnel = t;
+        s->context = ctx;
+        s->_doEmit();
+        veto = s->getVeto();
+#endif
+    }
+
+    // 判断激活数是否达到设置
+    if (s->count && s->emitedCount >= s->count) {
+        expired = true;
+    }
+    return veto;
+}
+
+bool Slots::_timed(slot_type const &s, Slot::data_type const &d, Slot::tunnel_type const &t, double now) {
+    auto timer = s->timer.ptr();
+    auto sig = signal;
+    if (s->delay && timer) {
+        timer->schedule(s->delay, [s, sig, d, t]() {
+            _deliver(s, sig, d, t);
+        });
+        return false;
+    }
+
+    if (!timer)
+        return !s->_throttle(now);
+
+    auto tm = s->_timing();
+    lock_type lck(tm->mtx);
+    if (s->debounce) {
+        // 重新计时
+        if (tm->id)
+            timer->cancel(tm->id);
+        tm->data = d;
+        tm->tunnel = t;
+        auto seq = ++tm->seq;
+        tm->id = timer->schedule(s->debounce, [s, sig, seq]() {
+            _flush(s, sig, seq);
+        });
+        return false;
+    }
+
+    if (!s->_throttle(now)) {
+        // 新的数据立即调用，取消等待中的尾部调用
+        if (tm->id) {
+            timer->cancel(tm->id);
+            tm->id = 0;
+            tm->data = nullptr;
+            tm->tunnel = nullptr;
+            ++tm->seq;
+        }
+        return true;
+    }
+
+    // 窗口内只保留最后一次的数据，窗口结束时调用
+    tm->data = d;
+    tm->tunnel = t;
+    if (!tm->id) {
+        double wait = s->_epstm + 1. / s->eps - now;
+        auto seq = ++tm->seq;
+        tm->id = timer->schedule((unsigned) ::std::ceil(wait * 1000), [s, sig, seq]() {
+            _flush(s, sig, seq);
+        });
+    }
+    return false;
+}
+
+void Slots::_deliver(slot_type const &s, signal_t sig, Slot::data_type const &d, Slot::tunnel_type const &t) {
+    if (!s->_connected || s->_dropped || s->_blocked)
+        return;
+
+    // 所属对象可能已经析构
+    auto sigs = s->_owner.lock();
+    if (!sigs || !sigs->owner)
+        return;
+    auto ss = sigs->find(sig);
+    if (!ss || ss->isblocked())
+        return;
+
+    bool expired = false;
+    ss->_invoke(s, d, t, nullptr, expired);
+    if (expired)
+        ss->_compact();
+}
+
+void Slots::_flush(slot_type const &s, signal_t sig, uint64_t seq) {
+    Slot::data_type d;
+    Slot::tunnel_type t;
+    {
+        auto tm = s->_timing();
+        lock_type lck(tm->mtx);
+        if (tm->seq != seq)
+            return;
+        d = ::std::move(tm->data);
+        t = ::std::move(tm->tunnel);
+        tm->id = 0;
+
+        // 尾部调用开始新的节流窗口
+        if (s->eps)
+            s->_epstm = TimeCurrent();
+    }
+    _deliver(s, sig, d, t);
+}
+
+Slots::removed_type Slots::emit(Slot::data_type d, Slot::tunnel_type t, EmitContext *ctx) {
+    removed_type r;
+    if (_idle())
+        return r;
+
+    // 读取当前的插槽列表，不做复制
+    // 如果循环中存在对slots的修改(connect/disconnect)，则修改会作用在新的列表上，当前循环的列表保持不变
+    // 达到激活次数的插槽在循环结束后统一移除
+    bool expired = false;
+    {
+        auto snaps = _sticky ? _record(&d, 1) : _slots.read();
+        if (!snaps)
+            return r;
+
+        double now = 0;
+        auto &ss = *snaps;
+        if (ss.size() == 1) {
+            // 只有一个插槽时不需要分组和检查中断
+            _emitOne(ss[0], d, t, ctx, now, expired);
+        } else {
+            for (size_t i = 0; i < ss.size(); ++i) {
+                auto &s = ss[i];
+                // 相邻的并发插槽作为一组并行执行
+                auto pool = s->pool.ptr();
+                if (pool && !ctx) {
+                    size_t n = 1;
+                    while (i + n < ss.size() && ss[i + n]->pool.ptr() == pool)
+                        ++n;
+                    if (n > 1) {
+                        if (_emitParallel(*pool, &s, n, d, t, expired))
+                            break;
+                        i += n - 1;
+                        if (!_signals->owner)
+                            break;
+                        continue;
+                    }
+                }
+                // 阻断，停止执行
+                if (_emitOne(s, d, t, ctx, now, expired))
+                    break;
+
+                if (!_signals->owner) {
+                    // 如果运行过程中根对象已经析构，则停止执行
+                    break;
+                }
+            }
+        }
+    }
+
+    // 释放读取后再移除，没有嵌套的emit时可以直接原地修改
+    if (expired)
+        r = _compact();
+
+    if (!_signals->owner) {
+        // 返回空的列表，因为对象已经析构，会自动断开其他连接, 返回运行中断开的对象列表已经没有意义
+        r.clear();
+    }
+
+    return r;
+}
+
+void Slots::emitBatch(Slot::data_type const *payloads, size_t n, EmitOrder order) {
+    if (!n || _idle())
+        return;
+
+    bool expired = false;
+    double now = 0;
+    {
+        auto snaps = _sticky ? _record(payloads, n) : _slots.read();
+        if (!snaps)
+            return;
+
+        if (order == EmitOrder::SLOT_MAJOR) {
+            // 记录被中断的数据，后面的插槽跳过
+            ::std::vector<bool> vetoed(n);
+            for (auto &s : *snaps) {
+                for (size_t i = 0; i < n && _signals->owner; ++i) {
+                    if (!vetoed[i] && _emitOne(s, payloads[i], nullptr, nullptr, now, expired))
+                        vetoed[i] = true;
+                }
+                if (!_signals->owner)
+                    break;
+            }
+        } else {
+            for (size_t i = 0; i < n && _signals->owner; ++i) {
+                for (auto &s : *snaps) {
+                    if (_emitOne(s, payloads[i], nullptr, nullptr, now, expired) || !_signals->owner)
+                        break;
+                }
+            }
+        }
+    }
+
+    if (expired)
+        _compact();
+}
+
+size_t Slots::sticky() const {
+    return _sticky ? _sticky->ring.size() : 0;
+}
+
+CowPtr<Slots::slots_type>::Reader Slots::_record(Slot::data_type const *payloads, size_t n) {
+    // 在锁内读取插槽列表，列表中的插槽直接收到数据，之后连接的插槽从补发中收到
+    lock_type lck(_sticky->mtx);
+    for (size_t i = 0; i < n; ++i) {
+        _sticky->push(payloads[i]);
+    }
+    return _slots.read();
+}
+
+void Slots::_add(slot_type const &s, ::std::vector<Slot::data_type> &replay) {
+    add(s);
+    if (_sticky)
+        _sticky->copy(replay);
+}
+
+void Slots::_replay(slot_type const &s, ::std::vector<Slot::data_type> const &payloads) {
+    bool expired = false;
+    double now = 0;
+    for (auto &d : payloads) {
+        if (!_signals->owner || isblocked())
+            break;
+        _emitOne(s, d, nullptr, nullptr, now, expired);
+    }
+
+    if (expired)
+        _compact();
+}
+
+Connection Signals::once(SignalKey const &sig, Slot::callback_type cb, int priority) {
+    return _connect(sig, ::std::move(cb), nullptr, 1, priority);
+}
+
+Connection Signals::once(SignalKey const &sig, Slot::pfn_membercallback_type cb, Object *target, int priority) {
+    return _connect(sig, Slot::callback_type(cb, target), target, 1, priority);
+}
+
+bool Slots::disconnect(Slot::callback_type const &cb) {
+    lock_type lck(_signals->_mtx);
+    if (!findByFunction(cb))
+        return false;
+
+    _erase([&](slot_type const &s) {
+        return s->cb == cb;
+    });
+    return true;
+}
+
+bool Slots::disconnect(Slot::pfn_membercallback_type cb, Object *target) {
+    auto pred = [=](slot_type const &s) {
+        if (!s->_connected || (cb && s->cb.member() != cb))
+            return false;
+        return s->target == target;
+    };
+
+    lock_type lck(_signals->_mtx);
+    {
+        // 先查找，避免没有匹配时也复制列表
+        auto snaps = _slots.read();
+        if (!snaps || ::std::none_of(snaps->begin(), snaps->end(), pred))
+            return false;
+    }
+
+    _erase(pred);
+    return true;
+}
+
+Slots::slot_type Slots::findByFunction(Slot::callback_type const &cb) const {
+    auto snaps = _slots.read();
+    if (!snaps)
+        return nullptr;
+    for (auto &s : *snaps) {
+        if (s->_connected && s->cb == cb) {
+            return s;
+        }
+    }
+    return nullptr;
+}
+
+Slots::slot_type Slots::findByFunction(Slot::pfn_membercallback_type cb, Object *target) const {
+    auto snaps = _slots.read();
+    if (!snaps)
+        return nullptr;
+    for (auto &s : *snaps) {
+        if (s->_connected && s->cb.member() == cb && s->target == target) {
+            return s;
+        }
+    }
+    return nullptr;
+}
+
+bool Slots::isConnected(Object *target) const {
+    auto snaps = _slots.read();
+    if (!snaps)
+        return false;
+    for (auto &s : *snaps) {
+        if (s->_connected && s->target == target) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t Slots::size() const {
+    return _live;
+}
+
+::std::set<Object *> Slots::targets() const {
+    ::std::set<Object *> r;
+    auto snaps = _slots.read();
+    if (snaps) {
+        for (auto &s : *snaps) {
+            if (s->_connected && s->target)
+                r.insert(s->target);
+        }
+    }
+    return r;
+}
+
+// ---------------------------------------- connection
+
+Connection::Connection(Slots::slot_type s)
+        : _slot(::std::move(s)) {
+    // pass
+}
+
+Connection::Connection(::std::shared_ptr<TypedSlot> s)
+        : _typed(::std::move(s)) {
+    // pass
+}
+
+bool Connection::connected() const {
+    if (_typed)
+        return _typed->_isconnected();
+    return _slot && _slot->_isconnected();
+}
+
+bool Connection::disconnect() {
+    if (_typed) {
+        if (!_typed->_isconnected())
+            return false;
+        auto sigs = _typed->_owner.lock();
+        if (!sigs)
+            return false;
+
+        // 持有锁时插槽依旧连接说明所属的信号依旧有效
+        lock_type lck(sigs->_mtx);
+        return _typed->_signal->_remove(*_typed);
+    }
+
+    if (!_slot || !_slot->_connected)
+        return false;
+
+    // 所属的对象可能已经析构
+    auto sigs = _slot->_owner.lock();
+    if (!sigs)
+        return false;
+
+    // 持有锁时插槽依旧连接说明 _holder 依旧有效
+    lock_type lck(sigs->_mtx);
+    return _slot->_holder->_remove(*_slot);
+}
+
+void Connection::block() {
+    if (_typed)
+        _typed->_blocked = true;
+    if (_slot)
+        _slot->_blocked = true;
+}
+
+void Connection::unblock() {
+    if (_typed)
+        _typed->_blocked = false;
+    if (_slot)
+        _slot->_blocked = false;
+}
+
+bool Connection::blocked() const {
+    if (_typed)
+        return _typed->_blocked;
+    if (!_slot)
+        return false;
+    if (_slot->_blocked)
+        return true;
+
+    auto sigs = _slot->_owner.lock();
+    if (!sigs)
+        return false;
+    lock_type lck(sigs->_mtx);
+    return _slot->_connected && _slot->_holder->isblocked();
+}
+
+ScopedConnection::ScopedConnection(Connection const &r)
+        : Connection(r) {
+    // pass
+}
+
+ScopedConnection::ScopedConnection(ScopedConnection &&r) noexcept
+        : Connection(r.release()) {
+    // pass
+}
+
+ScopedConnection &ScopedConnection::operator=(ScopedConnection &&r) noexcept {
+    if (this != &r) {
+        disconnect();
+        Connection::operator=(r.release());
+    }
+    return *this;
+}
+
+ScopedConnection::~ScopedConnection() {
+    disconnect();
+}
+
+Connection ScopedConnection::release() {
+    // 移动后两个插槽都置空，析构时不会再断开
+    return Connection(::std::move(static_cast<Connection &>(*this)));
+}
+
+Connection &Connection::throttle(unsigned short eps, TimerWheel &timer) {
+    if (_slot) {
+        _slot->eps = eps;
+        _slot->timer = &timer;
+    }
+    return *this;
+}
+
+Connection &Connection::debounce(unsigned ms, TimerWheel &timer) {
+    if (_slot) {
+        _slot->debounce = ms;
+        _slot->timer = &timer;
+    }
+    return *this;
+}
+
+Connection &Connection::delay(unsigned ms, TimerWheel &timer) {
+    if (_slot) {
+        _slot->delay = ms;
+        _slot->timer = &timer;
+    }
+    return *this;
+}
+
+Connection &Connection::concurrent(ThreadPool &pool) {
+    if (_slot)
+        _slot->pool = &pool;
+    return *this;
+}
+
+// ---------------------------------------- timer wheel
+
+TimerWheel::TimerWheel()
+    : _current(now())
+{
+    for (auto &b : _buckets) {
+        b.prev = b.next = &b;
+    }
+}
+
+TimerWheel::~TimerWheel() {
+    for (auto &e : _nodes) {
+        delete e.second;
+    }
+}
+
+uint64_t TimerWheel::now() {
+    auto now = ::std::chrono::steady_clock::now().time_since_epoch();
+    return ::std::chrono::duration_cast<::std::chrono::milliseconds>(now).count();
+}
+
+TimerWheel &TimerWheel::current() {
+    thread_local TimerWheel wheel;
+    return wheel;
+}
+
+TimerWheel::Link &TimerWheel::_bucket(unsigned level, size_t idx) {
+    if (level == 0)
+        return _buckets[idx];
+    return _buckets[(1 << ROOT_BITS) + (level - 1) * (1 << LEVEL_BITS) + idx];
+}
+
+void TimerWheel::_insert(Node *node) {
+    uint64_t delta = node->expire - _current;
+    Link *head;
+    if (delta < (1 << ROOT_BITS)) {
+        head = &_bucket(0, node->expire & ((1 << ROOT_BITS) - 1));
+    } else {
+        unsigned level = 1;
+        while (level < LEVELS && delta >= (uint64_t(1) << (ROOT_BITS + level * LEVEL_BITS)))
+            ++level;
+        uint64_t expire = node->expire;
+        // 超过最大范围的任务放在最高层的最远处，转动到时再重新分配
+        uint64_t limit = (uint64_t(1) << (ROOT_BITS + LEVELS * LEVEL_BITS)) - 1;
+        if (delta > limit)
+            expire = _current + limit;
+        unsigned shift = ROOT_BITS + (level - 1) * LEVEL_BITS;
+        head = &_bucket(level, (expire >> shift) & ((1 << LEVEL_BITS) - 1));
+    }
+
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+void TimerWheel::_step(::std::vector<Node *> &due) {
+    uint64_t t = _current;
+
+    // 第一层转完一圈时，把上层对应槽中的任务重新分配到下层
+    if ((t & ((1 << ROOT_BITS) - 1)) == 0) {
+        for (unsigned level = 1; level <= LEVELS; ++level) {
+            unsigned shift = ROOT_BITS + (level - 1) * LEVEL_BITS;
+            size_t idx = (t >> shift) & ((1 << LEVEL_BITS) - 1);
+            Link &head = _bucket(level, idx);
+            Link *cur = head.next;
+            head.prev = head.next = &head;
+            while (cur != &head) {
+                Link *next = cur->next;
+                _insert(static_cast<Node *>(cur));
+                cur = next;
+            }
+            if (idx != 0)
+                break;
+        }
+    }
+
+    Link &head = _bucket(0, t & ((1 << ROOT_BITS) - 1));
+    Link *cur = head.next;
+    head.prev = head.next = &head;
+    while (cur != &head) {
+        Link *next = cur->next;
+        auto node = static_cast<Node *>(cur);
+        if (node->expire <= t) {
+            _nodes.erase(node->id);
+            due.emplace_back(node);
+        } else {
+            _insert(node);
+        }
+        cur = next;
+    }
+
+    ++_current;
+}
+
+TimerWheel::timer_id TimerWheel::schedule(unsigned delay, task_type task) {
+    auto node = new Node();
+    node->task = ::std::move(task);
+    uint64_t expire = now() + delay;
+
+    lock_type lck(_mtx);
+    node->expire = ::std::max(expire, _current);
+    node->id = ++_nextid;
+    _nodes[node->id] = node;
+    _insert(node);
+    return node->id;
+}
+
+bool TimerWheel::cancel(timer_id id) {
+    Node *node;
+    {
+        lock_type lck(_mtx);
+        auto fnd = _nodes.find(id);
+        if (fnd == _nodes.end())
+            return false;
+        node = fnd->second;
+        _nodes.erase(fnd);
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+    }
+    delete node;
+    return true;
+}
+
+size_t TimerWheel::tick() {
+    return advance(now());
+}
+
+size_t TimerWheel::advance(uint64_t now) {
+    ::std::vector<Node *> due;
+    {
+        lock_type lck(_mtx);
+        while (_current <= now) {
+            if (_nodes.empty()) {
+                // 没有任务时直接跳到目标时间
+                _current = now + 1;
+                break;
+            }
+            _step(due);
+        }
+    }
+
+    // 在锁外执行，任务中可以再次安排或者取消
+    for (auto node : due) {
+        node->task();
+        delete node;
+    }
+    return due.size();
+}
+
+size_t TimerWheel::size() const {
+    lock_type lck(_mtx);
+    return _nodes.size();
+}
+
+// ---------------------------------------- channel
+
+Channel::Channel(size_t capacity, Backpressure policy)
+    : policy(policy)
+{
+    size_t n = 2;
+    while (n < capacity)
+        n <<= 1;
+    _mask = n - 1;
+    _cells = new Cell[n];
+    for (size_t i = 0; i < n; ++i) {
+        _cells[i].seq.store(i, ::std::memory_order_relaxed);
+    }
+}
+
+Channel::~Channel() {
+    delete[] _cells;
+}
+
+bool Channel::_tryPush(Slot::data_type &d) {
+    auto pos = _enqueue.load(::std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+        cell = &_cells[pos & _mask];
+        auto seq = cell->seq.load(::std::memory_order_acquire);
+        auto diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (_enqueue.compare_exchange_weak(pos, pos + 1, ::std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            // 已满
+            return false;
+        } else {
+            pos = _enqueue.load(::std::memory_order_relaxed);
+        }
+    }
+    cell->data = ::std::move(d);
+    cell->seq.store(pos + 1, ::std::memory_order_release);
+    return true;
+}
+
+bool Channel::_tryPop(Slot::data_type &d) {
+    auto pos = _dequeue.load(::std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+        cell = &_cells[pos & _mask];
+        auto seq = cell->seq.load(::std::memory_order_acquire);
+        auto diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (_dequeue.compare_exchange_weak(pos, pos + 1, ::std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            // 为空
+            return false;
+        } else {
+            pos = _dequeue.load(::std::memory_order_relaxed);
+        }
+    }
+    d = ::std::move(cell->data);
+    cell->seq.store(pos + _mask + 1, ::std::memory_order_release);
+    return true;
+}
+
+bool Channel::_takeLatest(Slot::data_type &d) {
+    if (!_hasLatest.load(::std::memory_order_acquire))
+        return false;
+    ::std::lock_guard<::std::mutex> lck(_latestMtx);
+    if (!_hasLatest.load(::std::memory_order_relaxed))
+        return false;
+    d = ::std::move(_latest);
+    _hasLatest.store(false, ::std::memory_order_release);
+    return true;
+}
+
+void Channel::_notify(::std::atomic<bool> &waiting) {
+    // 双方都使用读-改-写，和等待方的标记之间有全序，避免丢失唤醒
+    if (waiting.exchange(false)) {
+        ::std::lock_guard<::std::mutex> lck(_mtx);
+        _cv.notify_all();
+    }
+}
+
+bool Channel::push(Slot::data_type d) {
+    if (_closed.load(::std::memory_order_relaxed))
+        return false;
+
+    // 已经存在合并的数据时，新的数据只能继续合并，否则会排在更早的数据之前
+    if (!(policy == Backpressure::COALESCE && _hasLatest.load(::std::memory_order_acquire)) && _tryPush(d)) {
+        _notify(_readerWaiting);
+        return true;
+    }
+
+    switch (policy) {
+        case Backpressure::DROP_NEWEST: {
+            ++_dropped;
+            return false;
+        }
+        case Backpressure::DROP_OLDEST: {
+            Slot::data_type old;
+            while (!_tryPush(d)) {
+                if (_tryPop(old))
+                    ++_dropped;
+            }
+        } break;
+        case Backpressure::COALESCE: {
+            ::std::lock_guard<::std::mutex> lck(_latestMtx);
+            if (_hasLatest.load(::std::memory_order_relaxed))
+                ++_dropped;
+            _latest = ::std::move(d);
+            _hasLatest.store(true, ::std::memory_order_release);
+        } break;
+        case Backpressure::BLOCK: {
+            // 先标记休眠再检查一次，被唤醒时标记已经清除，需要重新标记
+            ::std::unique_lock<::std::mutex> lck(_mtx);
+            while (true) {
+                _writerWaiting.exchange(true);
+                if (_tryPush(d))
+                    break;
+                if (_closed)
+                    return false;
+                _cv.wait(lck);
+            }
+        } break;
+    }
+    _notify(_readerWaiting);
+    return true;
+}
+
+size_t Channel::pop(Slot::data_type *out, size_t n) {
+    size_t r = 0;
+    while (r < n && _tryPop(out[r])) {
+        ++r;
+    }
+    if (r < n && _takeLatest(out[r]))
+        ++r;
+    if (r && policy == Backpressure::BLOCK)
+        _notify(_writerWaiting);
+    return r;
+}
+
+size_t Channel::wait(Slot::data_type *out, size_t n) {
+    if (n == 0)
+        return 0;
+    while (true) {
+        auto r = pop(out, n);
+        if (r)
+            return r;
+
+        // 先标记休眠再检查一次，避免和生产者之间丢失唤醒
+        ::std::unique_lock<::std::mutex> lck(_mtx);
+        while (true) {
+            _readerWaiting.exchange(true);
+            if (size() != 0 || _hasLatest.load())
+                break;
+            if (_closed)
+                return 0;
+            _cv.wait(lck);
+        }
+    }
+}
+
+void Channel::close() {
+    {
+        ::std::lock_guard<::std::mutex> lck(_mtx);
+        _closed = true;
+    }
+    _cv.notify_all();
+}
+
+bool Channel::closed() const {
+    return _closed;
+}
+
+size_t Channel::capacity() const {
+    return _mask + 1;
+}
+
+size_t Channel::size() const {
+    auto deq = _dequeue.load();
+    auto enq = _enqueue.load();
+    return enq > deq ? enq - deq : 0;
+}
+
+size_t Channel::dropped() const {
+    return _dropped;
+}
+
+// ---------------------------------------- thread pool
+
+// 一次 parallel 调用的任务组，位于调用线程的栈上
+struct ThreadPool::Group {
+    ::std::atomic<size_t> pending;
+    ::std::mutex mtx;
+    ::std::condition_variable cv;
+};
+
+// 当前线程所属的线程池以及队列
+static thread_local ThreadPool *t_pool = nullptr;
+static thread_local size_t t_worker = 0;
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) {
+        size_t cores = ::std::thread::hardware_concurrency();
+        threads = cores > 1 ? cores - 1 : 1;
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        _workers.emplace_back(new Worker());
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        _threads.emplace_back([this, i]() {
+            _work(i);
+        });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        ::std::lock_guard<::std::mutex> lck(_mtx);
+        _stopped = true;
+    }
+    _cv.notify_all();
+    for (auto &t : _threads) {
+        t.join();
+    }
+}
+
+size_t ThreadPool::size() const {
+    return _workers.size();
+}
+
+ThreadPool &ThreadPool::shared() {
+    // 不析构，避免进程退出时和其他静态对象的析构顺序问题
+    static ThreadPool *pool = new ThreadPool();
+    return *pool;
+}
+
+void ThreadPool::_parallel(size_t n, void (*fn)(void *, size_t), void *ctx) {
+    if (n == 0)
+        return;
+
+    Group group;
+    group.pending = n;
+
+    // 第一个任务由调用线程执行，其余的投递到队列
+    bool inside = t_pool == this;
+    for (size_t i = 1; i < n; ++i) {
+        size_t idx = inside ? t_worker : _next++ % _workers.size();
+        auto &w = *_workers[idx];
+        ::std::lock_guard<::std::mutex> lck(w.mtx);
+        w.tasks.push_back(Task{fn, ctx, i, &group});
+    }
+    if (n > 1) {
+        {
+            ::std::lock_guard<::std::mutex> lck(_mtx);
+            _queued += n - 1;
+        }
+        _cv.notify_all();
+    }
+
+    _execute(Task{fn, ctx, 0, &group});
+
+    // 等待期间帮助执行队列中的任务
+    size_t self = inside ? t_worker : 0;
+    while (group.pending.load() != 0) {
+        Task task;
+        if (_take(task, self)) {
+            _execute(task);
+            continue;
+        }
+        ::std::unique_lock<::std::mutex> lck(group.mtx);
+        group.cv.wait(lck, [&]() {
+            return group.pending.load() == 0;
+        });
+    }
+
+    // 最后完成的任务在锁内通知，持有一次锁保证其已经不再访问group
+    ::std::lock_guard<::std::mutex> lck(group.mtx);
+}
+
+bool ThreadPool::_take(Task &task, size_t self) {
+    size_t n = _workers.size();
+    for (size_t k = 0; k < n; ++k) {
+        auto &w = *_workers[(self + k) % n];
+        ::std::lock_guard<::std::mutex> lck(w.mtx);
+        if (w.tasks.empty())
+            continue;
+        if (k == 0 && t_pool == this) {
+            task = w.tasks.back();
+            w.tasks.pop_back();
+        } else {
+            task = w.tasks.front();
+            w.tasks.pop_front();
+        }
+        --_queued;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::_execute(Task const &task) {
+    task.fn(task.ctx, task.idx);
+
+    auto &group = *task.group;
+    ::std::lock_guard<::std::mutex> lck(group.mtx);
+    if (--group.pending == 0)
+        group.cv.notify_all();
+}
+
+void ThreadPool::_work(size_t idx) {
+    t_pool = this;
+    t_worker = idx;
+    while (true) {
+        Task task;
+        if (_take(task, idx)) {
+            _execute(task);
+            continue;
+        }
+
+        ::std::unique_lock<::std::mutex> lck(_mtx);
+        _cv.wait(lck, [&]() {
+            return _stopped || _queued.load() != 0;
+        });
+        if (_stopped && _queued.load() == 0)
+            return;
+    }
+}
+
+// ---------------------------------------- signals
+
+Signals::Signals(Object* _owner)
+    : owner(_owner)
+{
+    // pass
+}
+
+Signals::~Signals() {
+    clear();
+    owner = nullptr;
+}
+
+void Signals::clear() {
+    // 清空反向的连接
+    decltype(_inverses) snaps;
+    {
+        lock_type lck(_invmtx);
+        snaps.swap(_inverses);
+    }
+    for (auto &iter: snaps) {
+        // 对方可能正在其他线程中析构，使用弱引用保护
+        // 批量析构中对方同样会析构时不需要断开，对方析构时也不会再访问自己
+        auto peer = iter.second.lock();
+        if (peer) {
+            if (peer->_isDoomed())
+                peer->_forget(owner);
+            else
+                peer->disconnectOfTarget(owner);
+        }
+    }
+
+    lock_type lck(_mtx);
+
+    // 清空slot的连接，清空时会从连接目标中移除反向连接
+    {
+        auto sigs = _signals.read();
+        if (sigs) {
+            for (auto &iter: *sigs) {
+                if (iter.second)
+                    iter.second->clear();
+            }
+        }
+    }
+    _signals.reset();
+    {
+        auto tables = _declared.read();
+        if (tables) {
+            for (auto &t: *tables) {
+                for (auto &ss: t->slots) {
+                    ss->clear();
+                }
+            }
+        }
+    }
+    _declared.reset();
+
+    // 清空类型化信号的连接
+    for (auto &iter: _typeds) {
+        iter->clear();
+    }
+}
+
+void Signals::_detach() {
+    lock_type lck(_mtx);
+    owner = nullptr;
+}
+
+void Signals::_compactDropped() {
+    lock_type lck(_mtx);
+    auto compact = [](slots_type const &ss) {
+        if (ss && ss->_dead) {
+            ss->_erase([](Slots::slot_type const &) {
+                return false;
+            });
+        }
+    };
+    {
+        auto sigs = _signals.read();
+        if (sigs) {
+            for (auto &iter : *sigs) {
+                compact(iter.second);
+            }
+        }
+    }
+    auto tables = _declared.read();
+    if (tables) {
+        for (auto &t : *tables) {
+            for (auto &ss : t->slots) {
+                compact(ss);
+            }
+        }
+    }
+}
+
+void Signals::_forget(Object *target) {
+    lock_type lck(_mtx);
+    auto fnd = _targets.find(target);
+    if (fnd == _targets.end())
+        return;
+
+    auto entry = ::std::move(fnd->second);
+    _targets.erase(fnd);
+    for (auto &s : entry.slots) {
+        if (!s->_connected)
+            continue;
+        s->_connected = false;
+        s->_dropped = true;
+        ++s->_holder->_dead;
+        --s->_holder->_live;
+    }
+    for (auto &typed : entry.typeds) {
+        typed->disconnectOfTarget(target);
+    }
+}
+
+void Signals::_link(Object *target) {
+    if (target == nullptr || target == owner)
+        return;
+    auto &peer = target->signals();
+    lock_type lck(peer._invmtx);
+    peer._inverses.emplace(this, weak_from_this());
+}
+
+void Signals::_unlink(Object *target) {
+    if (target == nullptr || target == owner)
+        return;
+    auto &peer = target->signals();
+
+    // 双方都即将析构，对方析构时弱引用已经失效
+    if (_isDoomed() && peer._isDoomed())
+        return;
+    lock_type lck(peer._invmtx);
+    peer._inverses.erase(this);
+}
+
+void Signals::_track(Object *target, Slots::slot_type const &s) {
+    if (target == nullptr)
+        return;
+    auto &entry = _targets[target];
+    if (entry.slots.empty() && entry.typeds.empty())
+        _link(target);
+    s->_tindex = entry.slots.size();
+    entry.slots.emplace_back(s);
+}
+
+void Signals::_track(Object *target, SignalBase *typed) {
+    if (target == nullptr)
+        return;
+    auto &entry = _targets[target];
+    if (entry.slots.empty() && entry.typeds.empty())
+        _link(target);
+    if (::std::find(entry.typeds.begin(), entry.typeds.end(), typed) == entry.typeds.end())
+        entry.typeds.emplace_back(typed);
+}
+
+void Signals::_untrack(Object *target, Slot *s) {
+    if (target == nullptr)
+        return;
+    auto fnd = _targets.find(target);
+    if (fnd == _targets.end())
+        return;
+
+    // 和最后一个交换后移除
+    auto &slots = fnd->second.slots;
+    auto idx = s->_tindex;
+    if (idx >= slots.size() || slots[idx].get() != s)
+        return;
+    slots[idx] = ::std::move(slots.back());
+    slots[idx]->_tindex = idx;
+    slots.pop_back();
+
+    if (slots.empty() && fnd->second.typeds.empty()) {
+        _targets.erase(fnd);
+        _unlink(target);
+    }
+}
+
+void Signals::_untrack(Object *target, SignalBase *typed) {
+    if (target == nullptr)
+        return;
+    auto fnd = _targets.find(target);
+    if (fnd == _targets.end())
+        return;
+
+    auto &typeds = fnd->second.typeds;
+    typeds.erase(::std::remove(typeds.begin(), typeds.end(), typed), typeds.end());
+
+    if (typeds.empty() && fnd->second.slots.empty()) {
+        _targets.erase(fnd);
+        _unlink(target);
+    }
+}
+
+Slots::slot_type Signals::_findOfTarget(Slots const &ss, Object *target, Slot::callback_type const &cb) const {
+    auto fnd = _targets.find(target);
+    if (fnd == _targets.end())
+        return nullptr;
+    for (auto &s : fnd->second.slots) {
+        if (s->_holder == &ss && s->_connected && s->cb == cb)
+            return s;
+    }
+    return nullptr;
+}
+
+bool Signals::registerr(::std::string_view sig, size_t sticky) {
+    return registerr(SignalNames::intern(sig), sticky);
 }
 
-void Slot::setVeto(bool b) {
-    _veto = b;
-    if (tunnel)
-        tunnel->veto = b;
-}
+bool Signals::registerr(signal_t sig, size_t sticky) {
+    if (sig == 0) {
+        SS_LOG_WARN("不能注册一个空信号")
+        return false;
+    }
 
-void Slot::emit(Slot::data_type d, Slot::tunnel_type t) {
-    if (eps) {
-        double now = TimeCurrent();
-        if (_epstm == 0) {
-            _epstm = now;
-        } else {
-            double el = now - _epstm;
-            //this._epstms = now; 注释以支持快速多次点击中可以按照频率命中一次，而不是全部都忽略掉
-            if ((1000 / el) > eps)
-                return;
-            _epstm = now; //命中一次后重置时间
-        }
+    lock_type lck(_mtx);
+    {
+        // 已经注册或者是已经创建的声明信号
+        bool registered;
+        _find(sig, registered);
+        if (registered)
+            return false;
     }
 
-    this->data = ::std::move(d);
-    this->tunnel = ::std::move(t);
+    // 插槽列表在第一次连接时才创建
+    _signals.write([&](signals_type &sigs) {
+        sigs.insert(::std::make_pair(sig, nullptr));
+    });
 
-    _doEmit();
+    // 粘性信号需要在连接之前保留数据，立即创建
+    if (sticky)
+        _materialize(sig)->_sticky.reset(new Slots::Replay(sticky));
+    return true;
 }
 
-void Slot::_doEmit() {
-    // 成员函数指针会将target通过bind到函数对象中，所以不需要采用传统调用成员指针的方法调用
-    // 普通函数指针可以直接调用
-    cb(*this);
-
-    // 清理
-    data = nullptr;
-    tunnel = nullptr;
+Signals::slots_type Signals::find(SignalKey const &sig) const {
+    bool registered;
+    auto ss = _find(sig, registered);
+    if (ss || !registered)
+        return ss;
 
-    // 增加计数
-    ++emitedCount;
+    lock_type lck(_mtx);
+    return _materialize(sig);
 }
 
-// --------------------------------------- slots
+Signals::slots_type Signals::_find(SignalKey const &sig, bool &registered, bool active) const {
+    // 不满足条件时不复制引用
+    auto accept = [=](slots_type const &ss) {
+        return ss && (!active || !ss->_idle());
+    };
+
+    if (sig.cls) {
+        // 声明的信号总是存在，找到所属类的表后按照索引直接访问
+        registered = true;
+        auto tables = _declared.peek();
+        if (tables) {
+            for (auto &t : *tables) {
+                if (t->cls == sig.cls)
+                    return accept(t->slots[sig.index]) ? t->slots[sig.index] : nullptr;
+            }
+        }
+        return nullptr;
+    }
 
-Slots::Slots()
-{
-    // pass
-}
+    registered = false;
+    {
+        auto sigs = _signals.peek();
+        if (sigs) {
+            auto fnd = sigs->find(sig.id);
+            if (fnd != sigs->end()) {
+                registered = true;
+                return accept(fnd->second) ? fnd->second : nullptr;
+            }
+        }
+    }
 
-Slots::~Slots() {
-    clear();
+    // 通过名称或者id访问已经创建的声明信号
+    auto tables = _declared.peek();
+    if (tables) {
+        for (auto &t : *tables) {
+            auto idx = t->cls->index(sig.id);
+            if (idx != t->cls->size()) {
+                registered = true;
+                return accept(t->slots[idx]) ? t->slots[idx] : nullptr;
+            }
+        }
+    }
+    return nullptr;
 }
 
-void Slots::clear() {
-    _slots.clear();
+Signals::slots_type Signals::_materialize(SignalKey const &sig) const {
+    // 其他线程可能已经创建
+    bool registered;
+    auto ss = _find(sig, registered);
+    if (ss || !registered)
+        return ss;
+
+    if (sig.cls) {
+        auto &cls = *sig.cls;
+        auto t = ::std::make_shared<DeclaredTable>();
+        t->cls = &cls;
+        t->slots.resize(cls.size());
+        for (unsigned i = 0; i < cls.size(); ++i) {
+            auto &s = t->slots[i];
+            s = make_pooled<Slots>();
+            s->_signals = const_cast<Signals *>(this);
+            s->signal = cls.id(i);
+            s->owner = owner;
+        }
+        _declared.write([&](declared_type &tables) {
+            tables.emplace_back(t);
+        });
+        return t->slots[sig.index];
+    }
+
+    ss = make_pooled<Slots>();
+    ss->_signals = const_cast<Signals *>(this);
+    ss->signal = sig.id;
+    ss->owner = owner;
+    _signals.write([&](signals_type &sigs) {
+        sigs[sig.id] = ss;
+    });
+    return ss;
 }
 
-void Slots::block() {
-    ++_blk;
+Connection Signals::connect(SignalKey const &sig, Slot::callback_type cb, int priority) {
+    return _connect(sig, ::std::move(cb), nullptr, 0, priority);
 }
 
-void Slots::unblock() {
-    --_blk;
+Connection Signals::connect(SignalKey const &sig, Slot::pfn_membercallback_type cb, Object *target, int priority) {
+    return _connect(sig, Slot::callback_type(cb, target), target, 0, priority);
 }
 
-bool Slots::isblocked() const {
-    return _blk != 0;
+Connection Signals::connect(SignalKey const &sig, Slot::callback_type cb, Dispatcher &dispatcher, int priority) {
+    return _connect(sig, ::std::move(cb), nullptr, 0, priority, &dispatcher);
 }
 
-void Slots::add(Slots::slot_type s) {
-    _slots.emplace_back(s);
+Connection Signals::connect(SignalKey const &sig, Channel &channel, int priority) {
+    Channel *ch = &channel;
+    return _connect(sig, [ch](Slot &s) {
+        ch->push(s.data);
+    }, nullptr, 0, priority);
 }
 
-::std::set<Object *> Slots::emit(Slot::data_type d, Slot::tunnel_type t) {
-    ::std::set<Object *> r;
-    if (isblocked())
-        return r;
+Connection Signals::_connect(SignalKey const &sig, Slot::callback_type cb, Object *target, size_t count, int priority, Dispatcher *dispatcher) {
+    // 粘性信号先于signals的锁持有记录的锁，直到补发结束，期间其他线程的激发等待记录
+    // 新插槽只从补发或者激发中的一处收到每个数据，并且补发的数据在之后激发的数据之前
+    slots_type sticky;
+    lock_type replayLck;
+    {
+        bool registered;
+        sticky = _find(sig, registered);
+        if (sticky && sticky->_sticky)
+            replayLck = lock_type(sticky->_sticky->mtx);
+    }
 
-    // 保存一份快照
-    // 如果循环中存在对slots的修改，则采用:
-    // 1, 总循环和emit使用快照
-    // 2, 删除使用查找-》删除
+    lock_type lck(_mtx);
+    auto ss = find(sig);
+    if (!ss) {
+        SS_LOG_WARN("对象信号 " + ::std::string(sig.name()) + " 不存在")
+        return {};
+    }
 
-    slots_type snaps = _slots;
-    for (size_t idx = 0; idx < snaps.size(); ++idx)
-    {
-        auto &s = snaps[idx];
-        if (s->count && (s->emitedCount >= s->count))
-            continue; // 已经达到设置激活的数量
-        
-        // 激发信号
-        s->signal = signal;
-        s->sender = owner;
-        s->emit(d, t);
+    // 判断是否已经连接，函数对象总是添加新的插槽，有连接对象时只查找连接到该对象的插槽
+    Slots::slot_type s;
+    if (cb.function() || cb.member())
+        s = target ? _findOfTarget(*ss, target, cb) : ss->findByFunction(cb);
+    if (s) {
+        if (count)
+            s->count = count;
+        return s;
+    }
 
-        // 判断激活数是否达到设置
-        if (s->count && s->emitedCount >= s->count) {
-            // 需要移除
-            if (s->target)
-                r.insert(s->target);
-            // 在_slots中查找删除
-            for (auto iter = _slots.begin(); iter != _slots.end(); ++iter)
-            {
-                if (*iter == s) {
-                    iter = _slots.erase(iter);
-                    break; // 找到即删除
-                }
-            }
-        }
+    s = make_pooled<Slot>();
+    s->cb = ::std::move(cb);
+    s->target = target;
+    s->count = count;
+    s->dispatcher = dispatcher;
+    s->priority = priority;
+    ::std::vector<Slot::data_type> replay;
+    ss->_add(s, replay);
+
+    // 如果连接的是自己，则不需要反向连接
+    _track(target, s);
+
+    // 粘性信号在释放锁之后补发保留的数据
+    if (!replay.empty()) {
+        lck.unlock();
+        ss->_replay(s, replay);
+    }
+    return s;
+}
 
-        // 阻断，停止执行
-        if (s->getVeto()) {
-            break;
-        }
+bool Signals::isConnected(SignalKey const &sig) const {
+    bool registered;
+    auto ss = _find(sig, registered);
+    return ss && ss->size() != 0;
+}
 
-        if (!_signals->owner) {
-            // 如果运行过程中根对象已经析构，则停止执行
-            break;
-        }
+void Signals::emit(SignalKey const &sig, Slot::data_type d, Slot::tunnel_type t) const {
+    // 持有slots避免owner析构 -> signals::clear -> 导致slots被释放
+    // 没有连接或者阻塞的信号不持有任何引用，直接返回
+    bool registered;
+    auto ss = _find(sig, registered, true);
+    if (!ss) {
+        // 注册了但是没有连接的信号
+        if (!registered)
+            SS_LOG_WARN("对象信号 " + ::std::string(sig.name()) + " 不存在")
+        return;
     }
 
-    if (!_signals->owner) {
-        // 返回空的列表，因为对象已经析构，会自动断开其他连接, 返回运行中断开的对象列表已经没有意义
-        r.clear();
+    // 保护signals，避免运行期被释放
+    ::std::shared_ptr<Signals const> lifekeep(shared_from_this());
+
+    // 达到激活次数被移除的插槽已经在 Slots::emit 中断开了反向连接
+    ss->emit(::std::move(d), ::std::move(t));
+}
+
+void Signals::emit(SignalKey const &sig, EmitContext &ctx, Slot::data_type d, Slot::tunnel_type t) const {
+    bool registered;
+    auto ss = _find(sig, registered, true);
+    if (!ss) {
+        if (!registered)
+            SS_LOG_WARN("对象信号 " + ::std::string(sig.name()) + " 不存在")
+        return;
     }
 
-    return r;
+    ::std::shared_ptr<Signals const> lifekeep(shared_from_this());
+
+    ss->emit(::std::move(d), ::std::move(t), &ctx);
 }
 
-Slots::slot_type Signals::once(signal_t const &sig, Slot::callback_type cb) {
-    auto r = connect(sig, cb);
-    if (r)
-        r->count = 1;
-    return r;
+void Signals::emitBatch(SignalKey const &sig, Slot::data_type const *payloads, size_t n, EmitOrder order) const {
+    bool registered;
+    auto ss = _find(sig, registered, true);
+    if (!ss) {
+        if (!registered)
+            SS_LOG_WARN("对象信号 " + ::std::string(sig.name()) + " 不存在")
+        return;
+    }
+
+    ::std::shared_ptr<Signals const> lifekeep(shared_from_this());
+
+    ss->emitBatch(payloads, n, order);
 }
 
-Slots::slot_type Signals::once(signal_t const &sig, Slot::pfn_callback_type cb) {
-    auto r = connect(sig, cb);
-    if (r)
-        r->count = 1;
-    return r;
+void Signals::disconnectOfTarget(Object *target) {
+    if (target == nullptr)
+        return;
+
+    lock_type lck(_mtx);
+    auto fnd = _targets.find(target);
+    if (fnd == _targets.end())
+        return;
+
+    // 只访问连接到target的插槽，标记断开后由各自的slots统一移除
+    auto entry = ::std::move(fnd->second);
+    _targets.erase(fnd);
+    for (auto &s : entry.slots) {
+        s->_holder->_remove(*s);
+    }
+    for (auto &typed : entry.typeds) {
+        typed->disconnectOfTarget(target);
+    }
+
+    _unlink(target);
 }
 
-Slots::slot_type Signals::once(signal_t const &sig, Slot::pfn_membercallback_type cb, Object *target) {
-    auto r = connect(sig, cb, target);
-    if (r)
-        r->count = 1;
-    return r;
+void Signals::disconnect(SignalKey const &sig) {
+    disconnect(sig, nullptr);
 }
 
-bool Slots::disconnect(Slot::pfn_callback_type cb) {
-    bool r = false;
-    for (auto iter = _slots.begin(); iter != _slots.end();) {
-        auto s = *iter;
+void Signals::disconnect(SignalKey const &sig, Slot::callback_type const &cb) {
+    lock_type lck(_mtx);
+    bool registered;
+    auto ss = _find(sig, registered);
+    if (!ss)
+        return;
 
-        if (s->_pfn_cb == cb) {
-            r = true;
-            iter = _slots.erase(iter);
-        } else {
-            ++iter;
-        }
+    if (!cb) {
+        // 清除sig的所有插槽，自动断开反向引用
+        ss->clear();
+    } else {
+        ss->disconnect(cb);
     }
-    return r;
 }
 
-bool Slots::disconnect(Slot::pfn_membercallback_type cb, Object *target) {
-    bool r = false;
-    for (auto iter = _slots.begin(); iter != _slots.end();) {
-        auto s = *iter;
+void Signals::disconnect(SignalKey const &sig, Slot::pfn_membercallback_type cb, Object *target) {
+    lock_type lck(_mtx);
+    bool registered;
+    auto ss = _find(sig, registered);
+    if (!ss)
+        return;
 
-        if (cb && s->_pfn_memcb != cb) {
-            ++iter;
-            continue;
+    if (cb == nullptr && target == nullptr) {
+        // 清除sig的所有插槽，自动断开反向引用
+        ss->clear();
+    } else if (target) {
+        // 只访问连接到target的插槽，标记断开后由slots统一移除
+        auto fnd = _targets.find(target);
+        if (fnd == _targets.end())
+            return;
+        ::std::vector<Slots::slot_type> matched;
+        for (auto &s : fnd->second.slots) {
+            if (s->_holder == ss.get() && (!cb || s->cb.member() == cb))
+                matched.emplace_back(s);
         }
-
-        if (s->target == target) {
-            r = true;
-            iter = _slots.erase(iter);
-        } else {
-            ++iter;
+        for (auto &s : matched) {
+            ss->_remove(*s);
         }
+    } else {
+        // 清除对应的slot，不再存在和target相连的插槽时会断开反向连接
+        ss->disconnect(cb, target);
     }
-    return r;
 }
 
-Slots::slot_type Slots::findByFunction(Slot::pfn_callback_type cb) const {
-    for (auto iter = _slots.begin(); iter != _slots.end(); ++iter) {
-        auto &s = *iter;
-        if (s->_pfn_cb == cb) {
-            return s;
-        }
-    }
-    return nullptr;
+bool Signals::isConnectedOfTarget(Object *target) const {
+    lock_type lck(_mtx);
+    return _targets.find(target) != _targets.end();
 }
 
-Slots::slot_type Slots::findByFunction(Slot::pfn_membercallback_type cb, Object *target) const {
-    for (auto iter = _slots.begin(); iter != _slots.end(); ++iter) {
-        auto &s = *iter;
-        if (s->_pfn_memcb == cb && s->target == target) {
-            return s;
-        }
-    }
-    return nullptr;
+void Signals::block(SignalKey const &sig) {
+    auto ss = find(sig);
+    if (ss)
+        ss->block();
 }
 
-bool Slots::isConnected(Object *target) const {
-    for (auto iter = _slots.begin(); iter != _slots.end(); ++iter) {
-        auto &s = *iter;
-        if (s->target == target) {
-            return true;
-        }
-    }
-    return false;
+void Signals::unblock(SignalKey const &sig) {
+    bool registered;
+    auto ss = _find(sig, registered);
+    if (ss)
+        ss->unblock();
 }
 
-size_t Slots::size() const {
-    return _slots.size();
+bool Signals::isblocked(SignalKey const &sig) const {
+    bool registered;
+    auto ss = _find(sig, registered);
+    return ss ? ss->isblocked() : false;
 }
 
-// ---------------------------------------- signals
+void Signals::synchronize() {
+#if SS_THREADSAFE
+    Epoch::synchronize();
+#endif
+}
 
-Signals::Signals(Object* _owner)
-    : owner(_owner)
+// ---------------------------------------- dispatcher
+
+Dispatcher::Dispatcher()
+    : _head(&_stub), _tail(&_stub)
 {
     // pass
 }
 
-Signals::~Signals() {
-    clear();
-    owner = nullptr;
+Dispatcher::~Dispatcher() {
+    Node *node;
+    while ((node = _pop()) != nullptr) {
+        delete node;
+    }
 }
 
-void Signals::clear() {
-    // 清空反向的连接
-    auto snaps = _inverses;
-    for (auto &iter: snaps) {
-        if (iter->owner && iter->owner != owner) {
-            iter->owner->signals().disconnectOfTarget(owner);
-        }
-    }
-    _inverses.clear();
+Dispatcher &Dispatcher::current() {
+    thread_local Dispatcher dispatcher;
+    return dispatcher;
+}
 
-    // 清空slot的连接
-    for (auto &iter: _signals) {
-        auto& ss = iter.second;
-        for (auto& iter : ss->_slots) {
-            if (iter->target && iter->target != owner) {
-                disconnect(iter->signal, iter->_pfn_memcb, iter->target);
-            }
-        }
-        ss->clear();
+void Dispatcher::_push(Node *node) {
+    node->next.store(nullptr);
+    auto prev = _head.exchange(node);
+    prev->next.store(node);
+
+    // 消费者准备休眠时才需要唤醒
+    if (_sleeping.exchange(false)) {
+        ::std::lock_guard<::std::mutex> lck(_mtx);
+        _cv.notify_one();
     }
-    _signals.clear();
 }
 
-bool Signals::registerr(signal_t const &sig) {
-    if (sig.empty()) {
-        SS_LOG_WARN("不能注册一个空信号")
-        return false;
+Dispatcher::Node *Dispatcher::_pop() {
+    auto tail = _tail;
+    auto next = tail->next.load();
+    if (tail == &_stub) {
+        if (next == nullptr)
+            return nullptr;
+        _tail = next;
+        tail = next;
+        next = next->next.load();
     }
 
-    if (_signals.find(sig) != _signals.end())
-        return false;
-
-    auto ss = ::std::make_shared<Slots>();
-    ss->_signals = this;
-    ss->signal = sig;
-    ss->owner = owner;
-    _signals.insert(::std::make_pair(sig, ss));
-    return true;
-}
-
-Signals::slots_type Signals::find(signal_t const& s) const {
-    auto fnd = _signals.find(s);
-    return fnd == _signals.end() ? nullptr : fnd->second;
-}
+    if (next) {
+        _tail = next;
+        return tail;
+    }
 
-Slots::slot_type Signals::connect(signal_t const &sig, Slot::pfn_callback_type cb) {
-    auto fnd = _signals.find(sig);
-    if (fnd == _signals.end()) {
-        SS_LOG_WARN("对象信号 " + sig + " 不存在")
+    // 生产者已经交换了head但还没有链接next，稍后再取
+    if (tail != _head.load())
         return nullptr;
+
+    _push(&_stub);
+    next = tail->next.load();
+    if (next) {
+        _tail = next;
+        return tail;
     }
-    auto ss = fnd->second;
+    return nullptr;
+}
 
-    // 判断是否已经连接
-    auto s = ss->findByFunction(cb);
-    if (s)
-        return s;
+void Dispatcher::post(task_type task) {
+    auto node = new Node();
+    node->task = ::std::move(task);
+    _push(node);
+}
 
-    s = ::std::make_shared<Slot>();
-    s->_pfn_cb = cb;
-    s->cb = cb;
-    ss->add(s);
+void Dispatcher::_post(::std::shared_ptr<Slot> const &s, signal_t sig, Object *sender, Slot::data_type const &d, Slot::tunnel_type const &t) {
+    auto node = new Node();
+    node->slot = s;
+    if (s->target)
+        node->target = s->target->_shared();
+    node->sender = sender;
+    node->signal = sig;
+    node->data = d;
+    node->tunnel = t;
+    _push(node);
+}
 
-    return s;
+void Dispatcher::_post(void *coroutine, void (*handler)(void *, bool)) {
+    auto node = new Node();
+    node->coroutine = coroutine;
+    node->handler = handler;
+    _push(node);
 }
 
-Slots::slot_type Signals::connect(signal_t const &sig, Slot::callback_type cb) {
-    auto fnd = _signals.find(sig);
-    if (fnd == _signals.end()) {
-        SS_LOG_WARN("对象信号 " + sig + " 不存在")
-        return nullptr;
+void Dispatcher::_execute(Node *node) {
+    if (node->task) {
+        node->task();
+        return;
     }
-    auto ss = fnd->second;
-    auto s = ::std::make_shared<Slot>();
-
-    s->cb = std::move(cb);
-    ss->add(s);
-
-    return s;
-}
 
-Slots::slot_type Signals::connect(signal_t const &sig, Slot::pfn_membercallback_type cb, Object *target) {
-    auto fnd = _signals.find(sig);
-    if (fnd == _signals.end()) {
-        SS_LOG_WARN("对象信号 " + sig + " 不存在")
-        return nullptr;
+    if (node->coroutine) {
+        // 交出所有权，执行后不再由 Node 销毁
+        auto coroutine = node->coroutine;
+        node->coroutine = nullptr;
+        node->handler(coroutine, true);
+        return;
     }
-    auto ss = fnd->second;
 
-    // 判断是否已经连接
-    auto s = ss->findByFunction(cb, target);
-    if (s)
-        return s;
+    auto &s = node->slot;
 
-    s = ::std::make_shared<Slot>();
-    s->_pfn_memcb = cb;
-    s->cb = ::std::bind(cb, target, ::std::placeholders::_1);
-    s->target = target;
-    ss->add(s);
+    // 投递之后断开或者阻塞的插槽不再执行，和直接连接的检查一致
+    // 达到激活次数被移除的插槽已经占用了这一次激发，仍然执行
+    bool expired = s->count && s->emitedCount >= s->count;
+    if (s->_dropped || s->_blocked || (!s->_connected && !expired))
+        return;
 
-    // 将自己添加到连接目标的反向连接中，当对方析构时，对方会使用反向连接自动断开和当前的连接
-    // 如果连接的是自己，则不连接
-    if (target != owner) {
-        target->_s->_inverses.insert(this);
+    if (s->target) {
+        // 目标对象已经析构
+        auto target = node->target.lock();
+        if (!target || !target->owner)
+            return;
     }
 
-    return s;
+    // 队列连接的插槽只会在当前线程中执行，可以直接使用插槽保存激发的数据
+    s->signal = node->signal;
+    s->sender = node->sender;
+    s->data = ::std::move(node->data);
+    s->tunnel = ::std::move(node->tunnel);
+    s->cb(*s);
+    s->data = nullptr;
+    s->tunnel = nullptr;
 }
 
-Slots::slot_type Signals::_connect(signal_t const &sig, Slot::callback_type cb, Object *target, Slot::pfn_membercallback_type cbmem) {
-    auto fnd = _signals.find(sig);
-    if (fnd == _signals.end()) {
-        SS_LOG_WARN("对象信号 " + sig + " 不存在")
-        return nullptr;
+size_t Dispatcher::poll() {
+    size_t r = 0;
+    Node *node;
+    while ((node = _pop()) != nullptr) {
+        ::std::unique_ptr<Node> keep(node);
+        _execute(node);
+        ++r;
     }
-    auto ss = fnd->second;
+    return r;
+}
 
-    // 判断是否已经连接
-    auto s = ss->findByFunction(cbmem, target);
-    if (s)
-        return s;
+void Dispatcher::run() {
+    while (!_stopped) {
+        if (poll())
+            continue;
 
-    s = ::std::make_shared<Slot>();
-    s->_pfn_memcb = cbmem;
-    s->cb = ::std::move(cb);
-    s->target = target;
-    ss->add(s);
+        // 先标记休眠再检查一次，避免和生产者之间丢失唤醒
+        _sleeping = true;
+        if (poll()) {
+            _sleeping = false;
+            continue;
+        }
 
-    if (target != owner) {
-        target->_s->_inverses.insert(this);
+        ::std::unique_lock<::std::mutex> lck(_mtx);
+        _cv.wait(lck, [this]() {
+            return !_sleeping || _stopped;
+        });
     }
 
-    return s;
+    // 允许再次运行
+    _stopped = false;
 }
 
-bool Signals::isConnected(signal_t const &sig) const {
-    auto fnd = _signals.find(sig);
-    return fnd != _signals.end() && !fnd->second->_slots.empty();
+void Dispatcher::stop() {
+    _stopped = true;
+    ::std::lock_guard<::std::mutex> lck(_mtx);
+    _sleeping = false;
+    _cv.notify_one();
 }
 
-void Signals::emit(signal_t const &sig, Slot::data_type d, Slot::tunnel_type t) const {
-    // 保护signals，避免运行期被释放
-    ::std::shared_ptr<Signals> lifekeep(owner->_s);
+// ---------------------------------------- typed signal
 
-    auto fnd = _signals.find(sig);
-    if (fnd == _signals.end()) {
-        SS_LOG_WARN("对象信号 " + sig + " 不存在")
-        return;
-    }
+SignalBase::SignalBase(Object *_owner)
+    : owner(_owner)
+{
+    // 第一次连接时才注册到所属对象的Signals中
+}
 
-    // 使用快照避免owner析构 -> signals::clear -> 导致slots被释放
-    auto snaps = fnd->second;
-    auto targets = snaps->emit(d, t);
-    if (!targets.empty()) {
-        // 收集所有被移除的target，并断开反向连接
-        for (auto &iter: targets) {
-            if (!isConnectedOfTarget(iter)) {
-                iter->_s->_inverses.erase(const_cast<Signals*>(this));
-            }
-        }
+SignalBase::~SignalBase() {
+    _detach();
+    owner = nullptr;
+}
+
+lock_type SignalBase::_lock() const {
+    Signals *sigs = owner->_s;
+    return sigs ? lock_type(sigs->_mtx) : lock_type();
+}
+
+lock_type SignalBase::_attach() {
+    auto &sigs = owner->signals();
+    lock_type lck(sigs._mtx);
+    if (!_attached) {
+        sigs._typeds.emplace_back(this);
+        _attached = true;
     }
+    return lck;
 }
 
-void Signals::disconnectOfTarget(Object *target) {
-    if (target == nullptr)
+void SignalBase::_detach() {
+    auto lck = _lock();
+    if (!_attached)
         return;
+    Signals *sigs = owner->_s;
+    auto &typeds = sigs->_typeds;
+    typeds.erase(::std::remove(typeds.begin(), typeds.end(), this), typeds.end());
+    _attached = false;
+}
 
-    for (auto &iter : _signals) {
-        iter.second->disconnect(nullptr, target);
-    }
+void SignalBase::_link(Object *target) {
+    owner->signals()._track(target, this);
+}
 
-    if (target != owner) {
-        if (!isConnectedOfTarget(target)) {
-            target->_s->_inverses.erase(const_cast<Signals*>(this));
-        }
-    }
+void SignalBase::_unlink(Object *target) {
+    if (!isConnectedOfTarget(target))
+        owner->signals()._untrack(target, this);
 }
 
-void Signals::disconnect(signal_t const &sig) {
-    disconnect(sig, nullptr);
+::std::shared_ptr<Signals> SignalBase::_lifekeep() const {
+    return owner->_shared();
 }
 
-void Signals::disconnect(signal_t const &sig, Slot::pfn_callback_type cb) {
-    auto fnd = _signals.find(sig);
-    if (fnd == _signals.end())
-        return;
-    auto &ss = fnd->second;
+// ---------------------------------------- object
 
-    if (cb == nullptr) {
-        // 清除sig的所有插槽，自动断开反向引用
-        ::std::set<Object *> targets;
-        for (const auto &iter:ss->_slots) {
-            if (iter->target)
-                targets.insert(iter->target);
-        }
-        ss->_slots.clear();
-        for (auto &iter:targets) {
-            if (!isConnectedOfTarget(iter)) {
-                iter->_s->_inverses.erase(const_cast<Signals*>(this));
-            }
-        }
-    } else {
-        ss->disconnect(cb);
+Object::~Object() {
+    Signals *s = _s;
+    if (s) {
+        s->clear();
+        s->_detach();
+        _s = nullptr;
+        _own = nullptr;
     }
 }
 
-void Signals::disconnect(signal_t const &sig, Slot::pfn_membercallback_type cb, Object *target) {
-    auto fnd = _signals.find(sig);
-    if (fnd == _signals.end())
-        return;
-    auto &ss = fnd->second;
+// ---------------------------------------- teardown
 
-    if (cb == nullptr && target == nullptr) {
-        // 清除sig的所有插槽，自动断开反向引用
-        ::std::set<Object *> targets;
-        for (const auto &iter:ss->_slots) {
-            if (iter->target)
-                targets.insert(iter->target);
-        }
-        ss->_slots.clear();
-        for (auto &iter:targets) {
-            if (!isConnectedOfTarget(iter)) {
-                iter->_s->_inverses.erase(const_cast<Signals*>(this));
-            }
-        }
+// 当前线程中最外层的批量析构作用域
+static thread_local TeardownScope *t_teardown = nullptr;
+static SS_ATOMIC(uint64_t) s_teardownGen{0};
+
+TeardownScope::TeardownScope()
+    : _outer(t_teardown)
+{
+    if (_outer) {
+        _gen = _outer->_gen;
     } else {
-        // 先清除对应的slot，再判断是否存在和target相连的插槽，如过不存在，则断开反向连接
-        if (ss->disconnect(cb, target) && target && !isConnectedOfTarget(target)) {
-            target->_s->_inverses.erase(const_cast<Signals*>(this));
-        }
+        _gen = ++s_teardownGen;
+        t_teardown = this;
     }
 }
 
-bool Signals::isConnectedOfTarget(Object *target) const {
-    for (auto iter = _signals.cbegin(); iter != _signals.end(); ++iter) {
-        if (iter->second->isConnected(target)) {
-            return true;
-        }
+TeardownScope::~TeardownScope() {
+    if (_outer)
+        return;
+    t_teardown = nullptr;
+
+    // 标记的对象已经全部析构，只剩下存活的对象
+    for (auto &iter : _dirty) {
+        auto sigs = iter.second.lock();
+        if (sigs && sigs->owner)
+            sigs->_compactDropped();
     }
-    return false;
 }
 
-void Signals::block(signal_t const &sig) {
-    auto fnd = _signals.find(sig);
-    if (fnd != _signals.end())
-        fnd->second->block();
+void TeardownScope::doom(Object const *obj) {
+    // 没有创建信号的对象不存在连接
+    Signals *sigs = obj ? (Signals *)obj->_s : nullptr;
+    if (sigs)
+        sigs->_doomed = _gen;
+}
+
+bool Signals::_isDoomed() const {
+    auto scope = t_teardown;
+    return scope && _doomed == scope->_gen;
+}
+
+bool TeardownScope::_defer(Signals &sigs) {
+    auto scope = t_teardown;
+    if (!scope)
+        return false;
+
+    // 即将析构的不需要压缩
+    if (sigs._doomed == scope->_gen)
+        return true;
+    auto &weak = scope->_dirty[&sigs];
+    if (weak.expired())
+        weak = sigs.weak_from_this();
+    return true;
+}
+
+Signals &Object::_materialize() const {
+    auto s = ::std::make_shared<Signals>(const_cast<Object *>(this));
+#if SS_THREADSAFE
+    // 多个线程同时创建时只保留第一个
+    Signals *expected = nullptr;
+    if (!_s.compare_exchange_strong(expected, s.get()))
+        return *expected;
+#else
+    _s = s.get();
+#endif
+    _own = ::std::move(s);
+    return *_s;
 }
 
-void Signals::unblock(signal_t const &sig) {
-    auto fnd = _signals.find(sig);
-    if (fnd != _signals.end())
-        fnd->second->unblock();
+::std::shared_ptr<Signals> Object::_shared() const {
+    Signals *s = _s;
+    return (s ? *s : _materialize()).shared_from_this();
 }
 
-bool Signals::isblocked(signal_t const &sig) const {
-    auto fnd = _signals.find(sig);
-    return fnd != _signals.end() ? fnd->second->isblocked() : false;
+SS_END
+
+// ---------------------------------------- buffer
+
+COMXX_BEGIN
+
+Buffer Buffer::map(::std::string const &path)
+{
+#if COMXX_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        return Buffer();
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return Buffer();
+    }
+    size_t size = (size_t)st.st_size;
+    void *mem = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // 映射建立后可以关闭文件
+    ::close(fd);
+    if (mem == MAP_FAILED)
+        return Buffer();
+    ::std::shared_ptr<void const> owner(mem, [size](void const *p) {
+        ::munmap(const_cast<void *>(p), size);
+    });
+    return Buffer(mem, size, ::std::move(owner));
+#else
+    (void)path;
+    return Buffer();
+#endif
 }
 
-SS_END
\ No newline at end of file
+COMXX_END
@@ -9,14 +9,44 @@
 #define SS_END }
 #define USE_SS using namespace SS_NS;
 
+// 多线程模式，打开后emit不加锁，connect/disconnect可以和emit并发执行
+#ifndef SS_THREADSAFE
+#define SS_THREADSAFE 0
+#endif
+
+// C++20 协程支持，co_await 等待信号以及协程插槽，只有头文件中的内联实现，库本身可以使用C++17编译
+#ifndef SS_COROUTINE
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L && __has_include(<coroutine>)
+#define SS_COROUTINE 1
+#else
+#define SS_COROUTINE 0
+#endif
+#endif
+
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <iostream>
 #include <functional>
+#include <iterator>
+#include <array>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#if SS_COROUTINE
+#include <coroutine>
+#endif
 
 SS_BEGIN
 
@@ -24,7 +54,8 @@ SS_BEGIN
 #define SS_LOG_INFO(msg) ::std::cout << (msg) << ::std::endl;
 #define SS_LOG_FATAL(msg) { ::std::cerr << (msg) << ::std::endl; throw msg; }
 
-typedef ::std::string signal_t;
+// 信号id，由 SignalNames 按名称统一分配，0 为空信号
+typedef unsigned int signal_t;
 
 class Object;
 
@@ -34,6 +65,20 @@ class Slots;
 
 class Signals;
 
+class SignalBase;
+
+class TypedSlot;
+
+class Dispatcher;
+
+class TimerWheel;
+
+class ThreadPool;
+
+class SignalAwaiter;
+
+class Channel;
+
 template<typename T>
 class attach_ptr {
 public:
@@ -68,288 +113,2538 @@ private:
     T *_ptr;
 };
 
-// 用于穿透整个emit流程的对象
-struct Tunnel {
+#if SS_THREADSAFE
 
-    // 是否请求中断了emit过程
-    bool veto;
+typedef ::std::recursive_mutex mutex_type;
 
-    // 附加数据
-    ::std::shared_ptr<::COMXX_NS::Variant<> > payload;
+#define SS_ATOMIC(T) ::std::atomic<T>
+
+// 基于epoch的延迟回收，读取方进入临界区后不需要加锁即可访问共享的对象
+class Epoch {
+public:
+
+    // 读取方的临界区，可以嵌套
+    class Guard {
+    public:
+
+        Guard();
+
+        Guard(Guard const &);
+
+        ~Guard();
+
+        Guard &operator=(Guard const &) = delete;
+    };
+
+    // 延迟释放对象，直到所有在此之前进入临界区的读取方都已经退出
+    static void retire(void *p, void (*deleter)(void *));
+
+    template<typename T>
+    static void retire(T *p) {
+        retire(p, [](void *p) {
+            delete static_cast<T *>(p);
+        });
+    }
+
+    // 等待其他线程中所有已经进入临界区的读取方退出
+    static void synchronize();
 };
 
-// 插槽对象
-class Slot {
+#else
+
+// 单线程模式下的空锁
+struct null_mutex {
+    void lock() {}
+    void unlock() {}
+    bool try_lock() { return true; }
+};
+
+typedef null_mutex mutex_type;
+
+#define SS_ATOMIC(T) T
+
+#endif
+
+typedef ::std::unique_lock<mutex_type> lock_type;
+
+// 写时复制的指针，读取不需要加锁，修改由调用方持有的锁保护
+// 单线程模式: 读取方持有引用，修改时如果存在读取方(emit中修改)则复制一份再修改
+// 多线程模式: 修改总是复制一份再原子地发布，旧的对象等待所有读取方退出后回收
+template<typename T>
+class CowPtr {
 public:
 
-    Slot();
-    ~Slot();
+    CowPtr() = default;
 
-    typedef void (*pfn_callback_type)(Slot &);
+    CowPtr(CowPtr const &) = delete;
 
-    typedef void (Object::*pfn_membercallback_type)(Slot &);
+    CowPtr &operator=(CowPtr const &) = delete;
 
-    // 基于function对象实现的slot不能disconnect和查询有无连接，受制于stl所限
-    typedef ::std::function<void(Slot &)> callback_type;
+    ~CowPtr() {
+        reset();
+    }
 
-    typedef ::std::shared_ptr<Tunnel> tunnel_type;
-    typedef ::std::shared_ptr<::COMXX_NS::Variant<> > payload_type;
-    typedef payload_type data_type;
+    // 读取的快照，生命周期内对象保持有效，期间发生的修改不可见
+    class Reader {
+    public:
 
-    // 通用回调对象
-    callback_type cb;
+        inline T const *get() const {
+            return _ptr;
+        }
 
-    // 回调函数归属的对象
-    attach_ptr<Object> target;
+        inline T const *operator->() const {
+            return _ptr;
+        }
 
-    // 激发对象
-    attach_ptr<Object> sender;
+        inline T const &operator*() const {
+            return *_ptr;
+        }
 
-    // 携带数据
-    data_type data;
+        inline explicit operator bool() const {
+            return _ptr != nullptr;
+        }
 
-    // 穿透整个调用流程的数据
-    tunnel_type tunnel;
+    private:
 
-    // connect 时附加的数据
-    payload_type payload;
+#if SS_THREADSAFE
+        explicit Reader(CowPtr const &r)
+            : _ptr(r._ptr.load()) {}
 
-    // 信号源名称
-    signal_t signal;
+        // 需要先于读取指针进入临界区
+        Epoch::Guard _guard;
+#else
+        explicit Reader(CowPtr const &r)
+            : _ref(r._ptr), _ptr(_ref.get()) {}
 
-    // 激发频率限制 (emits per second)
-    unsigned short eps = 0;
+        ::std::shared_ptr<T> _ref;
+#endif
+        T const *_ptr;
 
-    // 是否中断掉信号调用树
-    bool getVeto() const;
+        friend class CowPtr;
+    };
 
-    // 设置中断信号调用
-    void setVeto(bool b);
+    inline Reader read() const {
+        return Reader(*this);
+    }
 
-    // 调用几次自动解绑，默认为 null，不使用概设定
-    size_t count = 0;
-    size_t emitedCount = 0;
+    // 不调用外部代码的短暂读取，单线程模式下不持有引用，期间不能修改
+#if SS_THREADSAFE
+    inline Reader peek() const {
+        return Reader(*this);
+    }
+#else
+    inline T const *peek() const {
+        return _ptr.get();
+    }
+#endif
 
-    // 激发信号 @data 附带的数据，激发后自动解除引用
-    void emit(data_type data, tunnel_type tunnel);
+    // 修改对象，不存在则创建
+    template<typename F>
+    void write(F &&fn);
 
-protected:
+    // 清空
+    void reset();
 
-    void _doEmit();
+private:
+
+#if SS_THREADSAFE
+    ::std::atomic<T *> _ptr{nullptr};
+#else
+    ::std::shared_ptr<T> _ptr;
+#endif
+};
+
+#if SS_THREADSAFE
+
+template<typename T>
+template<typename F>
+inline void CowPtr<T>::write(F &&fn) {
+    T *old = _ptr.load();
+    T *cur = old ? new T(*old) : new T();
+    fn(*cur);
+    _ptr.store(cur);
+    if (old)
+        Epoch::retire(old);
+}
+
+template<typename T>
+inline void CowPtr<T>::reset() {
+    T *old = _ptr.exchange(nullptr);
+    if (old)
+        Epoch::retire(old);
+}
+
+#else
+
+template<typename T>
+template<typename F>
+inline void CowPtr<T>::write(F &&fn) {
+    if (!_ptr) {
+        _ptr = ::std::make_shared<T>();
+    } else if (_ptr.use_count() > 1) {
+        // 存在正在进行的emit，复制一份新的对象进行修改，emit继续使用原来的对象
+        _ptr = ::std::make_shared<T>(*_ptr);
+    }
+    fn(*_ptr);
+}
+
+template<typename T>
+inline void CowPtr<T>::reset() {
+    // 正在emit的读取方依旧持有原来的对象，直接丢弃引用即可
+    _ptr = nullptr;
+}
+
+#endif
+
+// 元素去重的小集合，不超过 N 个元素时存放在内联缓冲中，不分配内存，遍历顺序不固定
+// 超过之后转为堆上的有序数组
+template<typename T, size_t N>
+class SmallSet {
+public:
 
-    //  函数回调
-    pfn_callback_type _pfn_cb = nullptr;
+    // 插入元素，已经存在时返回false
+    bool insert(T const &v) {
+        if (_heap.empty()) {
+            if (::std::find(_inline, _inline + _size, v) != _inline + _size)
+                return false;
+            if (_size < N) {
+                _inline[_size++] = v;
+                return true;
+            }
+            _heap.assign(_inline, _inline + _size);
+            ::std::sort(_heap.begin(), _heap.end());
+        }
+        auto pos = ::std::lower_bound(_heap.begin(), _heap.end(), v);
+        if (pos != _heap.end() && *pos == v)
+            return false;
+        _heap.insert(pos, v);
+        _size = _heap.size();
+        return true;
+    }
+
+    inline size_t size() const {
+        return _size;
+    }
+
+    inline bool empty() const {
+        return _size == 0;
+    }
+
+    inline T const *begin() const {
+        return _heap.empty() ? _inline : _heap.data();
+    }
 
-    // 对象的函数回调
-    pfn_membercallback_type _pfn_memcb = nullptr;
+    inline T const *end() const {
+        return begin() + _size;
+    }
+
+    void clear() {
+        _heap.clear();
+        _size = 0;
+    }
 
 private:
 
-    double _epstm = 0;
-    bool _veto = false;
+    T _inline[N];
+    size_t _size = 0;
+    ::std::vector<T> _heap;
+};
 
-    friend class Slots;
-    friend class Signals;
+// 进程唯一的信号名称表，将信号名称映射为紧凑的整数id
+class SignalNames {
+public:
+
+    // 获得名称对应的信号id，不存在则分配一个新的id
+    static signal_t intern(::std::string_view name);
+
+    // 查找名称对应的信号id，不存在返回0，不加锁也不会分配内存
+    static signal_t find(::std::string_view name);
+
+    // 信号id对应的名称
+    static ::std::string const &name(signal_t sig);
+
+    // 已经分配的信号数量
+    static size_t size();
 };
 
-// 插槽集合
-class Slots {
+// 编译期声明的信号表，由 SS_SIGNALS 生成，每个信号有一个编译期确定的连续索引
+// 表本身是常量初始化的，名称在第一次使用时才注册为信号id，启动时不构造任何字符串
+class SignalClass {
 public:
 
-    Slots();
-    ~Slots();
+    constexpr SignalClass(::std::string_view const *names, unsigned size, signal_t *ids)
+        : _names(names), _size(size), _ids(ids) {}
 
-    typedef ::std::shared_ptr<Slot> slot_type;
+    SignalClass(SignalClass const &) = delete;
 
-    // 所有者，会传递到 Slot 的 sender
-    attach_ptr<Object> owner;
+    SignalClass &operator=(SignalClass const &) = delete;
 
-    // 信号源名称
-    signal_t signal;
+    // 声明的信号数量
+    inline unsigned size() const {
+        return _size;
+    }
 
-    // 清空连接
-    void clear();
+    inline ::std::string_view name(unsigned idx) const {
+        return _names[idx];
+    }
 
-    // 阻塞所有插槽
-    void block();
+    // 信号id，第一次访问时注册该类所有的信号名称
+    signal_t id(unsigned idx) const;
 
-    // 解阻
-    void unblock();
+    // id对应的索引，不是该类声明的信号时返回 size()
+    unsigned index(signal_t sig) const;
 
-    // 是否已经阻塞
-    bool isblocked() const;
+    // 逗号分隔的名称列表中的名称数量
+    static constexpr unsigned count(::std::string_view list) {
+        unsigned n = 1;
+        for (auto c : list) {
+            if (c == ',')
+                ++n;
+        }
+        return n;
+    }
 
-    // 添加一个插槽
-    void add(slot_type s);
+    // 拆分逗号分隔的名称列表，去掉两端的空白
+    template<unsigned N>
+    static constexpr ::std::array<::std::string_view, N> split(::std::string_view list) {
+        ::std::array<::std::string_view, N> r{};
+        for (unsigned i = 0; i < N; ++i) {
+            auto end = list.find(',');
+            auto item = list.substr(0, end);
+            while (!item.empty() && _isspace(item.front()))
+                item.remove_prefix(1);
+            while (!item.empty() && _isspace(item.back()))
+                item.remove_suffix(1);
+            r[i] = item;
+            list = end == ::std::string_view::npos ? ::std::string_view() : list.substr(end + 1);
+        }
+        return r;
+    }
 
-    // 对所有插槽激发信号 @note 返回被移除的插槽的对象
-    ::std::set<Object *> emit(Slot::data_type data, Slot::tunnel_type tunnel);
+private:
 
-    // 移除
-    bool disconnect(Slot::pfn_callback_type cb);
+    static constexpr bool _isspace(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
 
-    // 移除
-    bool disconnect(Slot::pfn_membercallback_type cb, Object *target);
+    ::std::string_view const *_names;
+    unsigned _size;
+    signal_t *_ids;
+    mutable ::std::once_flag _once;
+};
 
-    // 查找插槽
-    slot_type findByFunction(Slot::pfn_callback_type cb) const;
+// 信号参数，可以直接传入信号id，也可以传入信号名称(查表转换为id)
+class SignalKey {
+public:
 
-    // 查找插槽
-    slot_type findByFunction(Slot::pfn_membercallback_type cb, Object *target) const;
+    SignalKey(signal_t sig)
+        : id(sig) {}
 
-    // 是否已经连接
-    bool isConnected(Object *target) const;
+    SignalKey(::std::string_view name)
+        : id(SignalNames::find(name)), _name(name) {}
 
-    // 已经连接的插槽数量
-    size_t size() const;
+    SignalKey(char const *name)
+        : SignalKey(::std::string_view(name)) {}
+
+    SignalKey(::std::string const &name)
+        : SignalKey(::std::string_view(name)) {}
+
+    // SS_SIGNALS 声明的信号，例如 Button::Sig::clicked，直接按照索引访问插槽
+    template<typename E, typename = decltype(ssSignalClass(::std::declval<E>()))>
+    SignalKey(E sig)
+        : SignalKey(ssSignalClass(sig), static_cast<unsigned>(sig)) {}
+
+    SignalKey(SignalClass const &cls, unsigned index)
+        : id(cls.id(index)), cls(&cls), index(index) {}
+
+    // 信号id
+    const signal_t id;
+
+    // 声明信号的类以及在类中的索引，不是声明的信号时为null
+    SignalClass const *const cls = nullptr;
+    const unsigned index = 0;
+
+    // 信号名称，用于输出日志
+    ::std::string_view name() const;
 
 private:
+    ::std::string_view _name;
+};
 
-    typedef ::std::vector<slot_type> slots_type;
+// 插槽对象(Slot/Slots)的分配器，connect/registerr 使用当前线程的分配器创建对象
+// 对象的控制块记录了分配器，所以释放总是回到分配它的分配器，可以在任意线程释放
+class Allocator {
+public:
 
-    // 保存所有插槽
-    slots_type _slots;
+    virtual ~Allocator() = default;
 
-    // 阻塞信号计数器 @note emit被阻塞的信号将不会有任何作用
-    int _blk = 0;
+    virtual void *allocate(size_t size) = 0;
 
-    // 隶属的signals
-    attach_ptr<Signals> _signals;
+    virtual void deallocate(void *p, size_t size) = 0;
 
-    friend class Signals;
+    // 对象实际使用的分配器，对象可能比分配器存活得更久时返回一个独立的实现
+    virtual Allocator &backing() { return *this; }
+
+    // 当前线程使用的分配器，默认为 PoolAllocator
+    static Allocator &current();
 };
 
-// 信号主类
-class Signals {
+// 默认分配器，按大小分级，每个线程维护自己的空闲链表
+class PoolAllocator : public Allocator {
 public:
 
-    // 信号必须依赖一个object，使得插槽可以实现为成员函数
-    explicit Signals(Object* owner);
-    
-    ~Signals();
+    virtual void *allocate(size_t size) override;
 
-    typedef ::std::shared_ptr<Slots> slots_type;
+    virtual void deallocate(void *p, size_t size) override;
 
-    // 清空
-    void clear();
+    static PoolAllocator &instance();
+};
 
-    // 注册信号
-    bool registerr(signal_t const &sig);
+// 用于批量创建的对象图，从大块内存中顺序分配，释放不归还内存
+// 析构时如果还有存活的对象，则内存在最后一个对象释放时回收
+class ArenaAllocator : public Allocator {
+public:
 
-    // 返回指定信号的所有插槽
-    slots_type find(signal_t const&) const;
+    explicit ArenaAllocator(size_t chunk = 64 * 1024);
 
-    // 信号的主体
-    attach_ptr<Object> owner;
+    ArenaAllocator(ArenaAllocator const &) = delete;
 
-    // 只连接一次，调用后自动断开
-    Slots::slot_type once(signal_t const &sig, Slot::callback_type cb);
+    ArenaAllocator &operator=(ArenaAllocator const &) = delete;
 
-    Slots::slot_type once(signal_t const &sig, Slot::pfn_callback_type cb);
+    virtual ~ArenaAllocator();
 
-    Slots::slot_type once(signal_t const &sig, Slot::pfn_membercallback_type cb, Object *target);
+    virtual void *allocate(size_t size) override;
 
-    template<typename C>
-    Slots::slot_type once(signal_t const &sig, void (C::*cb)(Slot &), C *target);
+    virtual void deallocate(void *p, size_t size) override;
+
+    virtual Allocator &backing() override;
 
-    // 连接信号插槽
-    Slots::slot_type connect(signal_t const &sig, Slot::callback_type cb);
+private:
 
-    Slots::slot_type connect(signal_t const &sig, Slot::pfn_callback_type cb);
+    struct State;
+    State *_state;
+};
 
-    Slots::slot_type connect(signal_t const &sig, Slot::pfn_membercallback_type cb, Object *target);
+// 在作用域内替换当前线程的分配器
+class AllocatorScope {
+public:
 
-    template<typename C>
-    Slots::slot_type connect(signal_t const &sig, void (C::*cb)(Slot &), C *target);
+    explicit AllocatorScope(Allocator &alloc);
 
-    // 该信号是否存在连接上的插槽
-    bool isConnected(signal_t const &sig) const;
+    AllocatorScope(AllocatorScope const &) = delete;
 
-    // 激发信号
-    void emit(signal_t const& sig, Slot::data_type data = nullptr, Slot::tunnel_type tunnel = nullptr) const;
+    AllocatorScope &operator=(AllocatorScope const &) = delete;
 
-    // 断开连接
-    void disconnectOfTarget(Object *target);
+    ~AllocatorScope();
 
-    void disconnect(signal_t const &sig);
+private:
+    Allocator *_prev;
+};
 
-    void disconnect(signal_t const &sig, Slot::pfn_callback_type cb);
+// 适配标准库的分配器接口，用于 allocate_shared
+template<typename T>
+class StdAllocator {
+public:
 
-    void disconnect(signal_t const &sig, Slot::pfn_membercallback_type cb, Object *target);
+    typedef T value_type;
 
-    bool isConnectedOfTarget(Object *target) const;
+    explicit StdAllocator(Allocator &alloc) : _alloc(&alloc.backing()) {}
 
-    // 阻塞一个信号，将不响应激发
-    void block(signal_t const &sig);
+    template<typename U>
+    StdAllocator(StdAllocator<U> const &r) : _alloc(r._alloc) {}
 
-    // 解阻
-    void unblock(signal_t const &sig);
+    T *allocate(size_t n) {
+        return static_cast<T *>(_alloc->allocate(n * sizeof(T)));
+    }
 
-    // 是否阻塞
-    bool isblocked(signal_t const &sig) const;
+    void deallocate(T *p, size_t n) {
+        _alloc->deallocate(p, n * sizeof(T));
+    }
 
-protected:
+    template<typename U>
+    bool operator==(StdAllocator<U> const &r) const { return _alloc == r._alloc; }
 
-    // 实现连接
-    Slots::slot_type _connect(signal_t const &sig, Slot::callback_type cb, Object *target, Slot::pfn_membercallback_type cbmem);
+    template<typename U>
+    bool operator!=(StdAllocator<U> const &r) const { return _alloc != r._alloc; }
 
 private:
+    Allocator *_alloc;
 
-    // 保存连接到自身信号的对象信号，用于反向断开
-    ::std::set<Signals*> _inverses;
-
-    // 保存所有的信号和插槽列表
-    typedef ::std::map<signal_t, slots_type> signals_type;
-    signals_type _signals;
+    template<typename U>
+    friend class StdAllocator;
 };
 
-template<typename C>
-inline Slots::slot_type Signals::once(signal_t const &sig, void (C::*cb)(Slot &), C *target) {
-    auto r = connect(sig, cb, target);
-    if (r)
-        r->count = 1;
-    return r;
+// 使用当前线程的分配器创建对象
+template<typename T, typename... Args>
+inline ::std::shared_ptr<T> make_pooled(Args &&... args) {
+    return ::std::allocate_shared<T>(StdAllocator<T>(Allocator::current()), ::std::forward<Args>(args)...);
 }
 
-template<typename C>
-inline Slots::slot_type Signals::connect(signal_t const &sig, void (C::*cb)(Slot &), C *target) {
-    return _connect(sig, ::std::bind(cb, target, ::std::placeholders::_1), target, (Slot::pfn_membercallback_type)cb);
+// 用于穿透整个emit流程的对象
+struct Tunnel {
+
+    // 是否请求中断了emit过程
+    bool veto;
+
+    // 附加数据
+    ::std::shared_ptr<::COMXX_NS::Variant<> > payload;
+};
+
+// 合并插槽通过 Slot::setResult 返回的结果，combine 返回false时中断激发，后续的插槽不再调用
+class Combiner {
+public:
+
+    typedef ::COMXX_NS::Variant<> value_type;
+    typedef value_type::VT VT;
+
+    virtual ~Combiner() = default;
+
+    virtual bool combine(value_type const &v) = 0;
+
+protected:
+
+    // 数值、布尔和字符类型转换为T，其他类型返回T()
+    template<typename T>
+    static T _cast(value_type const &v);
+
+    // 是否为空: NIL或者空的指针、对象
+    static bool _isnull(value_type const &v) {
+        return v.type() == VT::NIL ||
+               (v.type() == VT::POINTER && !v.toPointer()) ||
+               (v.type() == VT::OBJECT && !v.toObject());
+    }
+};
+
+template<typename T>
+inline T Combiner::_cast(value_type const &v) {
+    switch (v.type()) {
+        case VT::INT: return static_cast<T>(v.toInt());
+        case VT::UINT: return static_cast<T>(v.toUInt());
+        case VT::LONG: return static_cast<T>(v.toLong());
+        case VT::ULONG: return static_cast<T>(v.toULong());
+        case VT::SHORT: return static_cast<T>(v.toShort());
+        case VT::USHORT: return static_cast<T>(v.toUShort());
+        case VT::LONGLONG: return static_cast<T>(v.toLonglong());
+        case VT::ULONGLONG: return static_cast<T>(v.toULonglong());
+        case VT::FLOAT: return static_cast<T>(v.toFloat());
+        case VT::DOUBLE: return static_cast<T>(v.toDouble());
+        case VT::CHAR: return static_cast<T>(v.toChar());
+        case VT::UCHAR: return static_cast<T>(v.toUChar());
+        case VT::BOOLEAN: return static_cast<T>(v.toBool());
+        default: return T();
+    }
 }
 
-// 基础对象，用于实现成员函数插槽
-class Object {
+// 第一个不为空的结果，之后的插槽不再调用
+class FirstNotNullCombiner : public Combiner {
 public:
 
-    Object() 
-        :_s(::std::make_shared<Signals>(this))
-    {
-        // pass
+    virtual bool combine(value_type const &v) override {
+        if (_isnull(v))
+            return true;
+        result = v;
+        return false;
     }
 
-    virtual ~Object() {
-        if (_s) {
-            _s->clear();
-            _s->owner = nullptr;
-            _s = nullptr;
-        }
+    value_type result;
+};
+
+// 所有结果的数值之和
+template<typename T = double>
+class SumCombiner : public Combiner {
+public:
+
+    virtual bool combine(value_type const &v) override {
+        result += _cast<T>(v);
+        return true;
     }
 
-    inline Signals &signals() {
-        return *_s;
+    T result = T();
+};
+
+// 所有结果都为真(非0)，遇到第一个假时中断
+class AllTrueCombiner : public Combiner {
+public:
+
+    virtual bool combine(value_type const &v) override {
+        if (!_cast<bool>(v))
+            result = false;
+        return result;
     }
 
-    inline Signals const& signals() const {
-        return *_s;
+    bool result = true;
+};
+
+// 收集结果到调用方提供的缓冲中，超过容量的结果只计数不保存
+class CollectCombiner : public Combiner {
+public:
+
+    CollectCombiner(value_type *buf, size_t capacity)
+        : _buf(buf), _capacity(capacity) {}
+
+    template<size_t N>
+    explicit CollectCombiner(value_type (&buf)[N])
+        : CollectCombiner(buf, N) {}
+
+    virtual bool combine(value_type const &v) override {
+        if (_count < _capacity)
+            _buf[_count] = v;
+        ++_count;
+        return true;
+    }
+
+    // 保存到缓冲中的结果数
+    size_t size() const {
+        return ::std::min(_count, _capacity);
+    }
+
+    // 所有插槽返回的结果数，包括超过容量没有保存的
+    size_t count() const {
+        return _count;
     }
 
 private:
 
-    // 实现为shared指针，以用于emit时可以临时保护，避免直接被释放导致野指针
-    ::std::shared_ptr<Signals> _s;
-    friend class Signals;
+    value_type *_buf;
+    size_t _capacity;
+    size_t _count = 0;
 };
 
+// 在栈上创建的激发上下文，代替 Tunnel 获得激发是否被中断，设置了 combiner 时收集插槽的结果
+// 只对同步调用的插槽有效，队列连接以及延迟调用的插槽拿不到上下文
+class EmitContext {
+public:
+
+    EmitContext() = default;
+
+    explicit EmitContext(Combiner &combiner)
+        : _combiner(&combiner) {}
+
+    EmitContext(EmitContext const &) = delete;
+
+    EmitContext &operator=(EmitContext const &) = delete;
+
+    // 是否有插槽中断了激发
+    bool getVeto() const {
+        return _veto;
+    }
+
+    Combiner *combiner() const {
+        return _combiner;
+    }
+
+private:
+
+    bool _veto = false;
+    Combiner *_combiner = nullptr;
+
+    friend class Slot;
+};
+
+template<typename T>
+class Delegate;
+
+// 回调对象，函数指针和对象的成员函数直接调用，较小的函数对象保存在内部的缓冲中，超过缓冲大小的才在堆上分配
+// 两个回调相等: 相同的函数指针、相同的成员函数和对象，或者相同类型且相等的函数对象
+// 函数对象支持 == 时使用 ==，否则仅在可以平凡复制(例如只捕获了指针、引用的lambda)时逐字节比较
+template<typename R, typename... Args>
+class Delegate<R(Args...)> {
+public:
+
+    typedef R (*pfn_callback_type)(Args...);
+
+    typedef R (Object::*pfn_membercallback_type)(Args...);
+
+    // 内部缓冲的大小
+    static constexpr size_t INLINE_SIZE = 4 * sizeof(void *);
+
+    Delegate() noexcept {}
+
+    Delegate(::std::nullptr_t) noexcept {}
+
+    Delegate(pfn_callback_type fn) noexcept {
+        if (fn) {
+            _kind = FUNCTION;
+            _u.fn = fn;
+        }
+    }
+
+    Delegate(pfn_membercallback_type fn, Object *target) noexcept {
+        if (fn) {
+            _kind = MEMBER;
+            _u.mem.fn = fn;
+            _u.mem.target = target;
+        }
+    }
+
+    template<typename F, typename = typename ::std::enable_if<
+            !::std::is_same<typename ::std::decay<F>::type, Delegate>::value &&
+            ::std::is_invocable_r<R, typename ::std::decay<F>::type &, Args...>::value>::type>
+    Delegate(F &&f) {
+        typedef typename ::std::decay<F>::type functor_type;
+        if constexpr (::std::is_convertible<functor_type, pfn_callback_type>::value) {
+            // 没有捕获的lambda按照函数指针保存，可以和函数指针比较
+            pfn_callback_type fn = f;
+            if (fn) {
+                _kind = FUNCTION;
+                _u.fn = fn;
+            }
+        } else {
+            _kind = FUNCTOR;
+            _ops = &Functor<functor_type>::ops;
+            Functor<functor_type>::construct(_u.buf, ::std::forward<F>(f));
+        }
+    }
+
+    Delegate(Delegate const &r) {
+        _assign(r);
+    }
+
+    Delegate(Delegate &&r) noexcept {
+        _assign(::std::move(r));
+    }
+
+    ~Delegate() {
+        _reset();
+    }
+
+    Delegate &operator=(Delegate const &r) {
+        if (this != &r) {
+            _reset();
+            _assign(r);
+        }
+        return *this;
+    }
+
+    Delegate &operator=(Delegate &&r) noexcept {
+        if (this != &r) {
+            _reset();
+            _assign(::std::move(r));
+        }
+        return *this;
+    }
+
+    R operator()(Args... args) const {
+        switch (_kind) {
+            case FUNCTION:
+                return _u.fn(::std::forward<Args>(args)...);
+            case MEMBER:
+                return (_u.mem.target->*_u.mem.fn)(::std::forward<Args>(args)...);
+            case FUNCTOR:
+                return _ops->invoke(const_cast<unsigned char *>(_u.buf), ::std::forward<Args>(args)...);
+            default:
+                throw ::std::bad_function_call();
+        }
+    }
+
+    explicit operator bool() const {
+        return _kind != EMPTY;
+    }
+
+    bool operator==(Delegate const &r) const {
+        if (_kind != r._kind)
+            return false;
+        switch (_kind) {
+            case FUNCTION:
+                return _u.fn == r._u.fn;
+            case MEMBER:
+                return _u.mem.fn == r._u.mem.fn && _u.mem.target == r._u.mem.target;
+            case FUNCTOR:
+                return _ops == r._ops && _ops->equal(_u.buf, r._u.buf);
+            default:
+                return true;
+        }
+    }
+
+    bool operator!=(Delegate const &r) const {
+        return !(*this == r);
+    }
+
+    // 保存的函数指针，不是函数指针时返回 null
+    pfn_callback_type function() const {
+        return _kind == FUNCTION ? _u.fn : nullptr;
+    }
+
+    // 保存的成员函数，不是成员函数时返回 null
+    pfn_membercallback_type member() const {
+        return _kind == MEMBER ? _u.mem.fn : nullptr;
+    }
+
+private:
+
+    enum Kind : unsigned char {
+        EMPTY, FUNCTION, MEMBER, FUNCTOR
+    };
+
+    struct Ops {
+        R (*invoke)(void *, Args &&...);
+
+        void (*copy)(void *, void const *);
+
+        void (*move)(void *, void *);
+
+        void (*destroy)(void *);
+
+        bool (*equal)(void const *, void const *);
+    };
+
+    template<typename F>
+    struct Functor {
+
+        static constexpr bool inlined = sizeof(F) <= INLINE_SIZE &&
+                                        alignof(F) <= alignof(::std::max_align_t) &&
+                                        ::std::is_nothrow_move_constructible<F>::value;
+
+        static F *get(void *p) {
+            if constexpr (inlined)
+                return static_cast<F *>(p);
+            else
+                return *static_cast<F **>(p);
+        }
+
+        static F const *get(void const *p) {
+            return get(const_cast<void *>(p));
+        }
+
+        template<typename T>
+        static void construct(void *p, T &&f) {
+            if constexpr (inlined)
+                new(p) F(::std::forward<T>(f));
+            else
+                *static_cast<F **>(p) = new F(::std::forward<T>(f));
+        }
+
+        static R invoke(void *p, Args &&... args) {
+            return (*get(p))(::std::forward<Args>(args)...);
+        }
+
+        static void copy(void *dst, void const *src) {
+            construct(dst, *get(src));
+        }
+
+        static void move(void *dst, void *src) {
+            if constexpr (inlined) {
+                new(dst) F(::std::move(*get(src)));
+                get(src)->~F();
+            } else {
+                *static_cast<F **>(dst) = get(src);
+            }
+        }
+
+        static void destroy(void *p) {
+            if constexpr (inlined)
+                get(p)->~F();
+            else
+                delete get(p);
+        }
+
+        template<typename T, typename = void>
+        struct comparable : ::std::false_type {
+        };
+
+        template<typename T>
+        struct comparable<T, ::std::void_t<decltype(::std::declval<T const &>() == ::std::declval<T const &>())>>
+                : ::std::true_type {
+        };
+
+        static bool equal(void const *a, void const *b) {
+            if constexpr (comparable<F>::value)
+                return *get(a) == *get(b);
+            else if constexpr (::std::is_empty<F>::value)
+                return true;
+            else if constexpr (::std::is_trivially_copyable<F>::value)
+                return ::std::memcmp(get(a), get(b), sizeof(F)) == 0;
+            else
+                return false;
+        }
+
+        static constexpr Ops ops = {&invoke, &copy, &move, &destroy, &equal};
+    };
+
+    void _assign(Delegate const &r) {
+        _kind = r._kind;
+        _ops = r._ops;
+        if (_kind == FUNCTOR)
+            _ops->copy(_u.buf, r._u.buf);
+        else
+            _u = r._u;
+    }
+
+    void _assign(Delegate &&r) noexcept {
+        _kind = r._kind;
+        _ops = r._ops;
+        if (_kind == FUNCTOR)
+            _ops->move(_u.buf, r._u.buf);
+        else
+            _u = r._u;
+        r._kind = EMPTY;
+        r._ops = nullptr;
+    }
+
+    void _reset() {
+        if (_kind == FUNCTOR)
+            _ops->destroy(_u.buf);
+        _kind = EMPTY;
+        _ops = nullptr;
+    }
+
+    union Storage {
+        pfn_callback_type fn;
+
+        struct {
+            pfn_membercallback_type fn;
+            Object *target;
+        } mem;
+
+        alignas(::std::max_align_t) unsigned char buf[INLINE_SIZE];
+    };
+
+    Storage _u;
+    Ops const *_ops = nullptr;
+    Kind _kind = EMPTY;
+};
+
+#if SS_COROUTINE
+
+// 协程插槽的返回类型，协程创建后先挂起，由 executor 开始执行，执行结束后自动销毁
+class CoSlot {
+public:
+
+    struct promise_type {
+
+        CoSlot get_return_object() noexcept {
+            return CoSlot(::std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        ::std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        ::std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+
+        void return_void() noexcept {}
+
+        // 协程插槽不允许抛出异常
+        void unhandled_exception() noexcept {
+            ::std::terminate();
+        }
+    };
+
+    CoSlot(CoSlot &&r) noexcept : _h(r._h) {
+        r._h = nullptr;
+    }
+
+    CoSlot(CoSlot const &) = delete;
+
+    CoSlot &operator=(CoSlot const &) = delete;
+
+    // 没有开始执行的协程随之销毁
+    ~CoSlot() {
+        if (_h)
+            _h.destroy();
+    }
+
+    // 在当前线程中开始执行，之后由协程自己管理生命周期
+    void start() {
+        release().resume();
+    }
+
+    // 交出协程的所有权
+    ::std::coroutine_handle<> release() noexcept {
+        auto h = _h;
+        _h = nullptr;
+        return h;
+    }
+
+private:
+
+    explicit CoSlot(::std::coroutine_handle<promise_type> h) noexcept : _h(h) {}
+
+    ::std::coroutine_handle<promise_type> _h;
+};
+
+#endif
+
+// 插槽对象
+class Slot {
+public:
+
+    Slot();
+    ~Slot();
+
+    typedef void (*pfn_callback_type)(Slot &);
+
+    typedef void (Object::*pfn_membercallback_type)(Slot &);
+
+    // 函数对象只有可以比较时(见 Delegate)才能disconnect和查询有无连接
+    typedef Delegate<void(Slot &)> callback_type;
+
+    typedef ::std::shared_ptr<Tunnel> tunnel_type;
+    typedef ::std::shared_ptr<::COMXX_NS::Variant<> > payload_type;
+    typedef payload_type data_type;
+
+#if SS_COROUTINE
+    // 协程插槽，参数会复制到协程帧中，协程挂起后不要再访问函数对象的捕获
+    typedef Delegate<CoSlot(data_type)> coroutine_type;
+#endif
+
+    // 通用回调对象
+    callback_type cb;
+
+    // 回调函数归属的对象
+    attach_ptr<Object> target;
+
+    // 激发对象
+    attach_ptr<Object> sender;
+
+    // 携带数据
+    data_type data;
+
+    // 穿透整个调用流程的数据
+    tunnel_type tunnel;
+
+    // connect 时附加的数据
+    payload_type payload;
+
+    // 信号源名称
+    signal_t signal;
+
+    // 激发频率限制 (emits per second)，设置了timer时超过频率的激发会在窗口结束时使用最后一次的数据调用，否则丢弃
+    unsigned short eps = 0;
+
+    // 防抖(毫秒)，需要设置timer，连续激发时只在最后一次激发 debounce 毫秒后使用最后一次的数据调用
+    unsigned debounce = 0;
+
+    // 延迟(毫秒)，需要设置timer，每次激发都在 delay 毫秒后调用
+    unsigned delay = 0;
+
+    // 驱动节流尾部调用、防抖以及延迟调用的时间轮，插槽在调用 TimerWheel::tick 的线程中执行
+    attach_ptr<TimerWheel> timer;
+
+    // 队列连接的目标，设置后插槽会投递到dispatcher所在的线程中执行
+    attach_ptr<Dispatcher> dispatcher;
+
+    // 并发安全的插槽在该线程池中和相邻的并发插槽并行执行，只在 SS_THREADSAFE 下并行，否则整组顺序执行
+    attach_ptr<ThreadPool> pool;
+
+    // 优先级，越大越先调用，相同优先级按照连接的顺序，加入列表后不能修改
+    int priority = 0;
+
+    // 是否中断掉信号调用树
+    bool getVeto() const;
+
+    // 设置中断信号调用
+    void setVeto(bool b);
+
+    // 返回结果给激发方的 combiner，没有 combiner 时忽略，combiner 要求中断时同 setVeto(true)
+    void setResult(::COMXX_NS::Variant<> const &v);
+
+    // 本次激发的上下文，不是通过 EmitContext 激发的为null
+    attach_ptr<EmitContext> context;
+
+    // 调用几次自动解绑，默认为 null，不使用概设定
+    SS_ATOMIC(size_t) count = 0;
+    SS_ATOMIC(size_t) emitedCount = 0;
+
+    // 激发信号 @data 附带的数据，激发后自动解除引用
+    void emit(data_type data, tunnel_type tunnel);
+
+protected:
+
+    void _doEmit();
+
+    // 是否超过了激发频率的限制，@now 单调时钟的当前时间(秒)，没有超过时记录本次激发的时间
+    bool _throttle(double now);
+
+    // 占用一次激发，已经达到激活次数时返回false
+    bool _claim(size_t &idx);
+
+#if SS_THREADSAFE
+    // 多线程下同一个插槽可能同时在多个线程中激发，本次激发的数据保存在ctx中，返回是否激发
+    bool _emitConcurrent(Slot &ctx, signal_t sig, Object *sender, data_type const &d, tunnel_type const &t, EmitContext *ectx);
+#endif
+
+    // 是否在连接中，断开或者达到激活次数被移除后为false
+    bool _isconnected() const;
+
+private:
+
+    // 节流、防抖的状态，只在第一次需要时创建
+    struct Timing;
+
+    Timing *_timing();
+
+    SS_ATOMIC(double) _epstm = 0;
+    bool _veto = false;
+
+    SS_ATOMIC(Timing *) _tm = nullptr;
+
+    // 连接状态，修改由所属signals的锁保护
+    SS_ATOMIC(bool) _connected = false;
+    SS_ATOMIC(bool) _blocked = false;
+
+    // 通过 Connection 断开，在列表中等待移除，包括已经开始的emit都会跳过该插槽
+    SS_ATOMIC(bool) _dropped = false;
+
+    // 所属的signals和slots，用于通过 Connection 断开
+    ::std::weak_ptr<Signals> _owner;
+    Slots *_holder = nullptr;
+
+    // 在所属signals按照target索引的列表中的位置
+    size_t _tindex = 0;
+
+    friend class Slots;
+    friend class Signals;
+    friend class Dispatcher;
+    friend class Connection;
+};
+
+// 事件循环，执行其他线程通过队列连接投递过来的插槽
+// 投递使用无锁的多生产者单消费者队列，poll/run只能在所属的线程中调用
+class Dispatcher {
+public:
+
+    Dispatcher();
+
+    Dispatcher(Dispatcher const &) = delete;
+
+    Dispatcher &operator=(Dispatcher const &) = delete;
+
+    // 析构时丢弃还没有执行的任务
+    ~Dispatcher();
+
+    typedef ::std::function<void()> task_type;
+
+    // 投递任务，可以在任意线程中调用
+    void post(task_type task);
+
+    // 执行所有已经投递的任务，返回执行的数量
+    size_t poll();
+
+    // 循环执行任务，直到stop
+    void run();
+
+    // 停止run，可以在任意线程中调用
+    void stop();
+
+    // 当前线程的事件循环
+    static Dispatcher &current();
+
+private:
+
+    struct Node {
+        ::std::atomic<Node *> next{nullptr};
+
+        // 普通任务
+        task_type task;
+
+        // 队列连接的插槽，目标对象已经析构时不再执行
+        ::std::shared_ptr<Slot> slot;
+        ::std::weak_ptr<Signals> target;
+        Object *sender = nullptr;
+        signal_t signal = 0;
+        Slot::data_type data;
+        Slot::tunnel_type tunnel;
+
+        // 投递的协程，handler 的 run 为 true 时恢复执行，否则在丢弃时销毁
+        void *coroutine = nullptr;
+        void (*handler)(void *coroutine, bool run) = nullptr;
+
+        ~Node() {
+            if (coroutine)
+                handler(coroutine, false);
+        }
+    };
+
+    // 投递插槽调用，由 Slots::emit 调用
+    void _post(::std::shared_ptr<Slot> const &s, signal_t sig, Object *sender, Slot::data_type const &d, Slot::tunnel_type const &t);
+
+    // 投递协程，不依赖协程的头文件，库本身不需要使用C++20编译
+    void _post(void *coroutine, void (*handler)(void *, bool));
+
+    void _push(Node *node);
+
+    Node *_pop();
+
+    void _execute(Node *node);
+
+    // 生产者写入的一端
+    ::std::atomic<Node *> _head;
+
+    // 消费者读取的一端
+    Node *_tail;
+
+    Node _stub;
+
+    ::std::atomic<bool> _stopped{false};
+
+    // run等待任务时使用，只在消费者准备休眠时才需要通知
+    ::std::atomic<bool> _sleeping{false};
+    ::std::mutex _mtx;
+    ::std::condition_variable _cv;
+
+    friend class Slots;
+    friend class Signals;
+};
+
+// 分层时间轮，精度为1毫秒，由宿主的循环调用 tick 推进，任务在调用 tick 的线程中执行
+// 第一层256个槽，之后每层64个槽，添加、取消和每次推进都是O(1)
+class TimerWheel {
+public:
+
+    typedef ::std::function<void()> task_type;
+
+    typedef uint64_t timer_id;
+
+    TimerWheel();
+
+    TimerWheel(TimerWheel const &) = delete;
+
+    TimerWheel &operator=(TimerWheel const &) = delete;
+
+    ~TimerWheel();
+
+    // delay 毫秒后执行任务，返回用于取消的id
+    timer_id schedule(unsigned delay, task_type task);
+
+    // 取消还没有执行的任务
+    bool cancel(timer_id id);
+
+    // 推进到当前时间，执行所有到期的任务，返回执行的任务数
+    size_t tick();
+
+    // 推进到指定的时间(TimerWheel::now)
+    size_t advance(uint64_t now);
+
+    // 等待执行的任务数
+    size_t size() const;
+
+    // 单调时钟的当前时间(毫秒)
+    static uint64_t now();
+
+    // 当前线程的时间轮
+    static TimerWheel &current();
+
+private:
+
+    struct Link {
+        Link *prev;
+        Link *next;
+    };
+
+    struct Node : Link {
+        uint64_t expire;
+        timer_id id;
+        task_type task;
+    };
+
+    static const unsigned ROOT_BITS = 8;
+    static const unsigned LEVEL_BITS = 6;
+    static const unsigned LEVELS = 4;
+
+    Link &_bucket(unsigned level, size_t idx);
+
+    void _insert(Node *node);
+
+    // 处理 _current 对应的槽，到期的任务放入 due
+    void _step(::std::vector<Node *> &due);
+
+    mutable mutex_type _mtx;
+
+    // 下一个需要处理的时间
+    uint64_t _current;
+
+    timer_id _nextid = 0;
+
+    // 第一层以及之后每一层的槽，每个槽是一个环形链表的头
+    Link _buckets[(1 << ROOT_BITS) + LEVELS * (1 << LEVEL_BITS)];
+
+    ::std::unordered_map<timer_id, Node *> _nodes;
+};
+
+// 工作窃取的线程池，用于并行执行并发安全的插槽(见 Connection::concurrent)
+// 每个工作线程有自己的任务队列，空闲时从其他线程的队列中窃取，等待的线程也会参与执行，嵌套的并行调用不会死锁
+class ThreadPool {
+public:
+
+    // @threads 工作线程数，为0时使用CPU核数-1(至少1个)
+    explicit ThreadPool(size_t threads = 0);
+
+    ThreadPool(ThreadPool const &) = delete;
+
+    ThreadPool &operator=(ThreadPool const &) = delete;
+
+    // 执行完已经投递的任务后退出
+    ~ThreadPool();
+
+    // 工作线程数
+    size_t size() const;
+
+    // 并行执行 fn(0) ~ fn(n-1)，调用线程也会执行其中的任务，全部完成后返回，不分配内存
+    template<typename F>
+    void parallel(size_t n, F &&fn);
+
+    // 进程共享的线程池
+    static ThreadPool &shared();
+
+private:
+
+    struct Group;
+
+    struct Task {
+        void (*fn)(void *, size_t);
+        void *ctx;
+        size_t idx;
+        Group *group;
+    };
+
+    struct Worker {
+        ::std::mutex mtx;
+        ::std::deque<Task> tasks;
+    };
+
+    void _parallel(size_t n, void (*fn)(void *, size_t), void *ctx);
+
+    // 先从自己的队列尾部取，再从其他队列的头部窃取
+    bool _take(Task &task, size_t self);
+
+    void _execute(Task const &task);
+
+    void _work(size_t idx);
+
+    ::std::vector<::std::unique_ptr<Worker> > _workers;
+    ::std::vector<::std::thread> _threads;
+
+    // 空闲的工作线程等待新的任务
+    ::std::mutex _mtx;
+    ::std::condition_variable _cv;
+    ::std::atomic<size_t> _queued{0};
+    ::std::atomic<bool> _stopped{false};
+
+    // 外部线程投递时轮流选择队列
+    ::std::atomic<size_t> _next{0};
+};
+
+template<typename F>
+inline void ThreadPool::parallel(size_t n, F &&fn) {
+    typedef typename ::std::remove_reference<F>::type fn_type;
+    _parallel(n, [](void *ctx, size_t idx) {
+        (*static_cast<fn_type *>(ctx))(idx);
+    }, const_cast<void *>(static_cast<void const *>(&fn)));
+}
+
+// 通道写满时的处理策略
+enum struct Backpressure {
+    // 阻塞激发的线程直到消费者读出数据
+    BLOCK = 0,
+
+    // 丢弃最早的数据
+    DROP_OLDEST = 1,
+
+    // 丢弃新的数据
+    DROP_NEWEST = 2,
+
+    // 合并为最新的一个数据，消费者读完缓冲之后读取
+    COALESCE = 3,
+};
+
+// 有界的信号通道，激发时数据写入无锁的环形缓冲，消费者线程批量读取
+// 任意数量的生产者和消费者都是安全的，连接断开之后才能析构
+class Channel {
+public:
+
+    // 容量向上取整为2的幂
+    explicit Channel(size_t capacity, Backpressure policy = Backpressure::BLOCK);
+
+    Channel(Channel const &) = delete;
+
+    Channel &operator=(Channel const &) = delete;
+
+    ~Channel();
+
+    // 写入数据，被丢弃或者通道已经关闭时返回false
+    bool push(Slot::data_type d);
+
+    // 读出最多 n 个数据，不阻塞，返回读出的数量
+    size_t pop(Slot::data_type *out, size_t n);
+
+    // 阻塞直到读出至少一个数据，返回0表示通道已经关闭并且读完
+    size_t wait(Slot::data_type *out, size_t n);
+
+    // 关闭通道，唤醒所有等待的生产者和消费者，已经写入的数据依旧可以读出
+    void close();
+
+    bool closed() const;
+
+    size_t capacity() const;
+
+    // 近似的数据数量
+    size_t size() const;
+
+    // 因为写满而丢弃的数据数量
+    size_t dropped() const;
+
+    Backpressure const policy;
+
+private:
+
+    struct Cell {
+        ::std::atomic<size_t> seq;
+        Slot::data_type data;
+    };
+
+    bool _tryPush(Slot::data_type &d);
+
+    bool _tryPop(Slot::data_type &d);
+
+    // 取出合并的最新数据
+    bool _takeLatest(Slot::data_type &d);
+
+    // 唤醒等待中的另一端
+    void _notify(::std::atomic<bool> &waiting);
+
+    Cell *_cells;
+    size_t _mask;
+
+    // 生产者和消费者的位置分别位于独立的缓存行
+    alignas(64) ::std::atomic<size_t> _enqueue{0};
+    alignas(64) ::std::atomic<size_t> _dequeue{0};
+
+    alignas(64) ::std::atomic<size_t> _dropped{0};
+    ::std::atomic<bool> _closed{false};
+
+    // COALESCE 溢出的最新数据，存在时新的数据都写入这里以保证顺序
+    ::std::atomic<bool> _hasLatest{false};
+    ::std::mutex _latestMtx;
+    Slot::data_type _latest;
+
+    // 存在准备休眠的生产者和消费者，只在休眠时才需要通知
+    ::std::atomic<bool> _writerWaiting{false};
+    ::std::atomic<bool> _readerWaiting{false};
+    ::std::mutex _mtx;
+    ::std::condition_variable _cv;
+};
+
+// 批量激发的顺序
+enum struct EmitOrder {
+    // 每个数据依次激发所有插槽，和逐个emit的顺序相同
+    PAYLOAD_MAJOR = 0,
+
+    // 每个插槽连续处理所有的数据，指令缓存更友好，插槽之间的执行顺序和逐个emit不同
+    SLOT_MAJOR = 1,
+};
+
+// 插槽集合
+class Slots {
+public:
+
+    Slots();
+    ~Slots();
+
+    typedef ::std::shared_ptr<Slot> slot_type;
+
+    // 移除的插槽所连接的对象，通常只有几个
+    typedef SmallSet<Object *, 8> removed_type;
+
+    // 所有者，会传递到 Slot 的 sender
+    attach_ptr<Object> owner;
+
+    // 信号源名称
+    signal_t signal;
+
+    // 清空连接
+    void clear();
+
+    // 阻塞所有插槽
+    void block();
+
+    // 解阻
+    void unblock();
+
+    // 是否已经阻塞
+    bool isblocked() const;
+
+    // 添加一个插槽，按照优先级插入
+    void add(slot_type s);
+
+    // 对所有插槽激发信号 @note 返回被移除的插槽的对象
+    // 相邻的并发插槽作为一组并行执行，组内的中断在整组执行完之后生效，之后的插槽不再调用
+    // 使用 ctx 激发时 combiner 不是线程安全的，所有插槽顺序执行
+    // 没有连接或者阻塞时直接返回，只有一个插槽时直接调用
+    removed_type emit(Slot::data_type data, Slot::tunnel_type tunnel, EmitContext *ctx = nullptr);
+
+    // 使用同一份插槽列表依次激发多个数据，中断和激发次数按照每个数据单独计算
+    void emitBatch(Slot::data_type const *payloads, size_t n, EmitOrder order);
+
+    // 粘性信号保留的数据数量，0 为普通信号
+    size_t sticky() const;
+
+    // 移除
+    bool disconnect(Slot::callback_type const &cb);
+
+    // 移除
+    bool disconnect(Slot::pfn_membercallback_type cb, Object *target);
+
+    // 查找插槽
+    slot_type findByFunction(Slot::callback_type const &cb) const;
+
+    // 查找插槽
+    slot_type findByFunction(Slot::pfn_membercallback_type cb, Object *target) const;
+
+    // 是否已经连接
+    bool isConnected(Object *target) const;
+
+    // 已经连接的插槽数量
+    size_t size() const;
+
+    // 所有插槽连接的对象
+    ::std::set<Object *> targets() const;
+
+private:
+
+    typedef ::std::vector<slot_type> slots_type;
+
+    // 移除已经达到激活次数的插槽，并断开不再连接的对象的反向连接，返回移除的插槽所连接的对象
+    removed_type _compact();
+
+    // 移除满足条件的插槽以及已经断开的插槽，调用方持有signals的锁，返回移除的插槽所连接的对象
+    template<typename P>
+    removed_type _erase(P &&pred);
+
+    // 阻塞或者没有连接的插槽，激发不会有任何作用，粘性信号需要记录数据
+    inline bool _idle() const {
+        return _blk || (!_sticky && _live == 0);
+    }
+
+    // 断开一个插槽，只做标记，断开的插槽超过一半时再统一移除
+    bool _remove(Slot &s);
+
+    // 对一个插槽激发，返回是否请求中断，插槽达到激活次数时设置 expired
+    // @now 单调时钟的当前时间，为0时在第一个需要的插槽处读取，同一次激发的其他插槽复用
+    bool _emitOne(slot_type const &s, Slot::data_type const &d, Slot::tunnel_type const &t, EmitContext *ctx, double &now, bool &expired);
+
+    // 在线程池中并行激发连续的n个并发插槽，全部结束后返回是否有插槽请求中断
+    bool _emitParallel(ThreadPool &pool, slot_type const *slots, size_t n, Slot::data_type const &d, Slot::tunnel_type const &t, bool &expired);
+
+    // 调用插槽(或者投递到dispatcher)，返回是否请求中断
+    bool _invoke(slot_type const &s, Slot::data_type const &d, Slot::tunnel_type const &t, EmitContext *ctx, bool &expired);
+
+    // 处理节流、防抖以及延迟，返回是否需要立即调用
+    bool _timed(slot_type const &s, Slot::data_type const &d, Slot::tunnel_type const &t, double now);
+
+    // 时间轮到期后调用插槽
+    static void _deliver(slot_type const &s, signal_t sig, Slot::data_type const &d, Slot::tunnel_type const &t);
+
+    // 节流的尾部调用以及防抖到期，使用最后一次激发的数据调用插槽，@seq 之后又有新的激发时忽略
+    static void _flush(slot_type const &s, signal_t sig, uint64_t seq);
+
+    // 粘性信号保留的最近 n 个数据
+    struct Replay;
+
+    // 记录激发的数据，返回同一把锁内读取的插槽列表
+    CowPtr<slots_type>::Reader _record(Slot::data_type const *payloads, size_t n);
+
+    // 添加新连接的插槽，同时复制保留的数据，粘性信号由调用方持有记录的锁，保证新插槽的数据不会遗漏或者重复
+    void _add(slot_type const &s, ::std::vector<Slot::data_type> &replay);
+
+    // 将保留的数据依次发给新连接的插槽，调用方持有记录的锁
+    void _replay(slot_type const &s, ::std::vector<Slot::data_type> const &payloads);
+
+    // 保存所有插槽，emit直接读取当前的列表，不会复制，emit中的修改会作用到新的列表上(copy-on-write)
+    CowPtr<slots_type> _slots;
+
+    // 阻塞信号计数器 @note emit被阻塞的信号将不会有任何作用
+    SS_ATOMIC(int) _blk = 0;
+
+    // 已经断开但还保留在列表中的插槽数
+    SS_ATOMIC(size_t) _dead = 0;
+
+    // 依旧连接的插槽数，修改由锁保护，为0时激发不需要读取列表
+    // 只用一个计数器，避免分别读取两个计数器时中间发生的连接和断开使两者恰好相等
+    SS_ATOMIC(size_t) _live = 0;
+
+    // 隶属的signals
+    attach_ptr<Signals> _signals;
+
+    // 粘性信号在注册时创建
+    ::std::unique_ptr<Replay> _sticky;
+
+    friend class Signals;
+    friend class Connection;
+};
+
+// 连接的句柄，connect/once 返回，可以直接断开或阻塞对应的插槽而不需要查找
+// 类型化信号的连接只支持断开和阻塞，节流、防抖、延迟以及并发只作用于动态信号的插槽
+class Connection {
+public:
+
+    Connection() = default;
+
+    Connection(Slots::slot_type s);
+
+    Connection(::std::shared_ptr<TypedSlot> s);
+
+    // 是否依旧连接
+    bool connected() const;
+
+    // 断开连接，返回是否断开了连接
+    bool disconnect();
+
+    // 阻塞插槽，阻塞期间激发信号不会调用该插槽
+    void block();
+
+    // 解除阻塞
+    void unblock();
+
+    // 插槽或者所属的信号是否阻塞
+    bool blocked() const;
+
+    // 节流，每秒最多调用 eps 次，超过频率的激发在窗口结束时使用最后一次的数据调用
+    Connection &throttle(unsigned short eps, TimerWheel &timer);
+
+    // 防抖，连续激发时只在最后一次激发 ms 毫秒后使用最后一次的数据调用
+    Connection &debounce(unsigned ms, TimerWheel &timer);
+
+    // 延迟，每次激发都在 ms 毫秒后调用
+    Connection &delay(unsigned ms, TimerWheel &timer);
+
+    // 标记为并发安全，激发时和相邻的并发插槽在 pool 中并行执行
+    // 单线程模式(SS_THREADSAFE 为0)下不起作用，整组插槽仍在激发的线程中顺序执行
+    Connection &concurrent(ThreadPool &pool = ThreadPool::shared());
+
+    // 对应的插槽，类型化信号的连接为null
+    Slots::slot_type const &slot() const {
+        return _slot;
+    }
+
+    operator Slots::slot_type const &() const {
+        return _slot;
+    }
+
+    Slot *operator->() const {
+        return _slot.get();
+    }
+
+    explicit operator bool() const {
+        return _slot != nullptr || _typed != nullptr;
+    }
+
+protected:
+    Slots::slot_type _slot;
+    ::std::shared_ptr<TypedSlot> _typed;
+};
+
+// 析构时自动断开的连接
+class ScopedConnection : public Connection {
+public:
+
+    ScopedConnection() = default;
+
+    ScopedConnection(Connection const &r);
+
+    ScopedConnection(ScopedConnection &&r) noexcept;
+
+    ScopedConnection(ScopedConnection const &) = delete;
+
+    ScopedConnection &operator=(ScopedConnection &&r) noexcept;
+
+    ScopedConnection &operator=(ScopedConnection const &) = delete;
+
+    ~ScopedConnection();
+
+    // 放弃管理，析构时不再断开
+    Connection release();
+};
+
+// 信号主类
+// 多线程模式下:
+// 1, emit不加锁，和connect/disconnect/disconnectOfTarget以及对象析构可以并发执行
+// 2, 断开(包括连接对象析构导致的断开)返回后新开始的emit不会再调用该插槽，其他线程中已经开始的emit仍可能调用一次
+// 3, 如果插槽依赖对象的状态，对象析构时应先调用 signals().clear() 再调用 Signals::synchronize() 等待其他线程中的emit结束
+// 4, 对象析构和该对象自身的emit不能并发执行
+class Signals : public ::std::enable_shared_from_this<Signals> {
+public:
+
+    // 信号必须依赖一个object，使得插槽可以实现为成员函数
+    explicit Signals(Object* owner);
+    
+    ~Signals();
+
+    typedef ::std::shared_ptr<Slots> slots_type;
+
+    // 清空
+    void clear();
+
+    // 注册信号，sticky 不为0时为粘性信号，保留最近 sticky 个数据，新的连接立即按照顺序收到这些数据
+    // 粘性信号的插槽列表在注册时创建，没有连接时也会保留激发的数据
+    // 补发期间其他线程对该信号的激发等待补发结束，补发的插槽中不能等待其他线程激发该信号
+    bool registerr(signal_t sig, size_t sticky = 0);
+
+    bool registerr(::std::string_view sig, size_t sticky = 0);
+
+    // 返回指定信号的所有插槽，插槽列表在第一次连接或者访问时创建，信号不存在时返回null
+    slots_type find(SignalKey const &sig) const;
+
+    // 信号的主体
+    attach_ptr<Object> owner;
+
+    // 只连接一次，调用后自动断开
+    Connection once(SignalKey const &sig, Slot::callback_type cb, int priority = 0);
+
+    Connection once(SignalKey const &sig, Slot::pfn_membercallback_type cb, Object *target, int priority = 0);
+
+    template<typename C>
+    Connection once(SignalKey const &sig, void (C::*cb)(Slot &), C *target, int priority = 0);
+
+    // 连接信号插槽，@priority 越大越先调用，已经连接的插槽保持原来的优先级
+    Connection connect(SignalKey const &sig, Slot::callback_type cb, int priority = 0);
+
+    Connection connect(SignalKey const &sig, Slot::pfn_membercallback_type cb, Object *target, int priority = 0);
+
+    template<typename C>
+    Connection connect(SignalKey const &sig, void (C::*cb)(Slot &), C *target, int priority = 0);
+
+    // 队列连接，激发时插槽投递到dispatcher所在的线程中执行，不能中断信号调用
+    Connection connect(SignalKey const &sig, Slot::callback_type cb, Dispatcher &dispatcher, int priority = 0);
+
+    template<typename C>
+    Connection connect(SignalKey const &sig, void (C::*cb)(Slot &), C *target, Dispatcher &dispatcher, int priority = 0);
+
+    // 通道连接，激发时数据写入 channel，由消费者线程读取，不能中断信号调用
+    Connection connect(SignalKey const &sig, Channel &channel, int priority = 0);
+
+    // 该信号是否存在连接上的插槽
+    bool isConnected(SignalKey const &sig) const;
+
+    // 激发信号
+    void emit(SignalKey const &sig, Slot::data_type data = nullptr, Slot::tunnel_type tunnel = nullptr) const;
+
+    // 使用栈上的上下文激发，结束后通过 ctx 获得是否被中断以及合并的结果
+    void emit(SignalKey const &sig, EmitContext &ctx, Slot::data_type data = nullptr, Slot::tunnel_type tunnel = nullptr) const;
+
+    // 批量激发，信号只查找一次并使用同一份插槽列表，批量过程中新连接的插槽不会收到剩余的数据
+    void emitBatch(SignalKey const &sig, Slot::data_type const *payloads, size_t n, EmitOrder order = EmitOrder::PAYLOAD_MAJOR) const;
+
+    // 连续存储的数据，例如 vector<Slot::data_type>
+    template<typename Range>
+    void emitBatch(SignalKey const &sig, Range const &payloads, EmitOrder order = EmitOrder::PAYLOAD_MAJOR) const {
+        emitBatch(sig, ::std::data(payloads), ::std::size(payloads), order);
+    }
+
+    // 断开连接
+    void disconnectOfTarget(Object *target);
+
+    void disconnect(SignalKey const &sig);
+
+    // 断开所有相等的回调，cb 为空时断开所有插槽
+    void disconnect(SignalKey const &sig, Slot::callback_type const &cb);
+
+#if SS_COROUTINE
+    // 等待信号的下一次激发，co_await 返回激发的数据，对象析构或者等待中的协程销毁时断开
+    // 默认在激发的线程中恢复协程，传入 dispatcher 时在其线程中恢复
+    SignalAwaiter next(SignalKey const &sig);
+
+    SignalAwaiter next(SignalKey const &sig, Dispatcher &dispatcher);
+
+    // 协程插槽，激发时只创建协程，协程投递到 executor 中执行，不阻塞 emit
+    Connection connect(SignalKey const &sig, Slot::coroutine_type coro, Dispatcher &executor, int priority = 0);
+#endif
+
+    void disconnect(SignalKey const &sig, Slot::pfn_membercallback_type cb, Object *target);
+
+    bool isConnectedOfTarget(Object *target) const;
+
+    // 阻塞一个信号，将不响应激发
+    void block(SignalKey const &sig);
+
+    // 解阻
+    void unblock(SignalKey const &sig);
+
+    // 是否阻塞
+    bool isblocked(SignalKey const &sig) const;
+
+    // 等待其他线程中正在进行的emit结束，单线程模式下不做任何事 @note 不能在插槽中调用
+    static void synchronize();
+
+protected:
+
+    // 实现连接，激活次数在插槽加入列表之前设置，避免其他线程提前激发
+    Connection _connect(SignalKey const &sig, Slot::callback_type cb, Object *target, size_t count, int priority, Dispatcher *dispatcher = nullptr);
+
+private:
+
+    // 将自己添加到连接目标的反向连接中，当对方析构时，对方会使用反向连接自动断开和当前的连接
+    void _link(Object *target);
+
+    // 从target中移除反向连接
+    // @note 需要和移除插槽在同一个锁内，保证target在此期间不会析构完成
+    void _unlink(Object *target);
+
+    // 记录连接到target的插槽或者类型化信号，第一个连接时建立反向连接 @note 需要持有锁
+    void _track(Object *target, Slots::slot_type const &s);
+
+    void _track(Object *target, SignalBase *typed);
+
+    // 移除记录，target已经没有连接时移除反向连接 @note 需要持有锁
+    void _untrack(Object *target, Slot *s);
+
+    void _untrack(Object *target, SignalBase *typed);
+
+    // 通过连接对象的索引在 ss 中查找回调相同的插槽，只访问连接到target的插槽 @note 需要持有锁
+    Slots::slot_type _findOfTarget(Slots const &ss, Object *target, Slot::callback_type const &cb) const;
+
+    // 对象析构时解除关联
+    void _detach();
+
+    // 移除所有插槽列表中已经断开的插槽，批量析构结束时调用
+    void _compactDropped();
+
+    // 批量析构中同样标记的 target 析构，只移除索引并标记插槽断开，自己随后也会析构，不需要压缩和反向断开
+    void _forget(Object *target);
+
+    // 是否被当前线程的批量析构作用域标记
+    bool _isDoomed() const;
+
+    // 查找插槽列表但不创建，@registered 返回信号是否已经注册
+    // @active 为true时阻塞或者没有连接的插槽列表返回空，激发时不需要持有
+    slots_type _find(SignalKey const &sig, bool &registered, bool active = false) const;
+
+    // 创建已经注册的信号的插槽列表，声明的信号创建整个类的插槽表 @note 需要持有锁
+    slots_type _materialize(SignalKey const &sig) const;
+
+    // 保护信号表、插槽列表以及类型化信号的修改
+    mutable mutex_type _mtx;
+
+    // 标记为即将析构的批量析构作用域编号，作用域结束后自然失效
+    SS_ATOMIC(uint64_t) _doomed = 0;
+
+    // 只保护反向连接，持有时不会再获取其他的锁
+    mutable mutex_type _invmtx;
+
+    // 保存连接到自身信号的对象信号，用于反向断开
+    ::std::map<Signals *, ::std::weak_ptr<Signals> > _inverses;
+
+    // 注册在该对象上的类型化信号
+    ::std::vector<SignalBase *> _typeds;
+
+    // 连接到同一个对象的插槽和类型化信号，插槽记录自己的位置，移除时和最后一个交换，O(1)
+    struct TargetEntry {
+        ::std::vector<Slots::slot_type> slots;
+        ::std::vector<SignalBase *> typeds;
+    };
+
+    // 按照连接对象索引，查询、断开某个对象的连接以及对象析构时只需要访问该对象的插槽，和信号源的插槽总数无关
+    ::std::unordered_map<Object *, TargetEntry> _targets;
+
+    // 保存所有的信号和插槽列表，没有连接过的信号插槽列表为null
+    typedef ::std::unordered_map<signal_t, slots_type> signals_type;
+    mutable CowPtr<signals_type> _signals;
+
+    // SS_SIGNALS 声明的信号，每个声明信号的类一个定长的插槽表，创建后不再修改
+    // 查找时按照类的指针比较找到表(一般只有一个)，再按照编译期的索引访问，不需要哈希查找
+    struct DeclaredTable {
+        SignalClass const *cls;
+        ::std::vector<slots_type> slots;
+    };
+
+    typedef ::std::vector<::std::shared_ptr<DeclaredTable const> > declared_type;
+    mutable CowPtr<declared_type> _declared;
+
+    friend class Object;
+    friend class Slots;
+    friend class SignalBase;
+    friend class Connection;
+    friend class SignalAwaiter;
+    friend class TeardownScope;
+};
+
+template<typename C>
+inline Connection Signals::once(SignalKey const &sig, void (C::*cb)(Slot &), C *target, int priority) {
+    return _connect(sig, Slot::callback_type((Slot::pfn_membercallback_type)cb, target), target, 1, priority);
+}
+
+template<typename C>
+inline Connection Signals::connect(SignalKey const &sig, void (C::*cb)(Slot &), C *target, int priority) {
+    return _connect(sig, Slot::callback_type((Slot::pfn_membercallback_type)cb, target), target, 0, priority);
+}
+
+template<typename C>
+inline Connection Signals::connect(SignalKey const &sig, void (C::*cb)(Slot &), C *target, Dispatcher &dispatcher, int priority) {
+    return _connect(sig, Slot::callback_type((Slot::pfn_membercallback_type)cb, target), target, 0, priority, &dispatcher);
+}
+
+#if SS_COROUTINE
+
+// co_await 等待信号的下一次激发，使用 count 为 1 的插槽实现，回调保存在插槽内部的缓冲中
+class SignalAwaiter {
+public:
+
+    SignalAwaiter(Signals &signals, SignalKey const &sig, Dispatcher *dispatcher)
+        : _signals(signals), _sig(sig), _dispatcher(dispatcher) {}
+
+    SignalAwaiter(SignalAwaiter const &) = delete;
+
+    SignalAwaiter &operator=(SignalAwaiter const &) = delete;
+
+    // 等待中的协程被销毁时断开插槽
+    ~SignalAwaiter() {
+        _conn.disconnect();
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    bool await_suspend(::std::coroutine_handle<> h) {
+        _handle = h;
+        _conn = _signals._connect(_sig, [this](Slot &s) {
+            _data = s.data;
+            // 连接返回之前已经激发时由 await_suspend 直接继续执行
+            if (_ready.exchange(true))
+                _handle.resume();
+        }, nullptr, 1, 0, _dispatcher);
+        return !_ready.exchange(true);
+    }
+
+    Slot::data_type await_resume() noexcept {
+        return ::std::move(_data);
+    }
+
+private:
+
+    Signals &_signals;
+    SignalKey _sig;
+    Dispatcher *_dispatcher;
+    ::std::coroutine_handle<> _handle;
+    Slot::data_type _data;
+    Connection _conn;
+
+    // 插槽回调和 await_suspend 中后执行的一方负责继续协程
+    ::std::atomic<bool> _ready{false};
+};
+
+inline SignalAwaiter Signals::next(SignalKey const &sig) {
+    return SignalAwaiter(*this, sig, nullptr);
+}
+
+inline SignalAwaiter Signals::next(SignalKey const &sig, Dispatcher &dispatcher) {
+    return SignalAwaiter(*this, sig, &dispatcher);
+}
+
+inline Connection Signals::connect(SignalKey const &sig, Slot::coroutine_type coro, Dispatcher &executor, int priority) {
+    Dispatcher *ex = &executor;
+    return _connect(sig, [coro = ::std::move(coro), ex](Slot &s) {
+        auto h = coro(s.data).release();
+        ex->_post(h.address(), [](void *addr, bool run) {
+            auto h = ::std::coroutine_handle<>::from_address(addr);
+            if (run)
+                h.resume();
+            else
+                h.destroy();
+        });
+    }, nullptr, 0, priority);
+}
+
+#endif
+
+// 基础对象，用于实现成员函数插槽
+class Object {
+public:
+
+    Object() = default;
+
+    Object(Object const &) = delete;
+
+    Object &operator=(Object const &) = delete;
+
+    virtual ~Object();
+
+    // 信号在第一次访问时创建，没有使用过信号的对象不分配内存
+    inline Signals &signals() {
+        Signals *s = _s;
+        return s ? *s : _materialize();
+    }
+
+    inline Signals const& signals() const {
+        Signals *s = _s;
+        return s ? *s : _materialize();
+    }
+
+    // 是否已经创建了信号
+    inline bool hasSignals() const {
+        return _s != nullptr;
+    }
+
+    // 激发信号，还没有创建Signals时直接返回，不会创建，也不检查信号是否存在
+    // 声明的信号没有连接过时总是如此，注册的信号在 registerr 时已经创建了Signals
+    inline void emit(SignalKey const &sig, Slot::data_type data = nullptr, Slot::tunnel_type tunnel = nullptr) const {
+        Signals *s = _s;
+        if (s)
+            s->emit(sig, ::std::move(data), ::std::move(tunnel));
+    }
+
+private:
+
+    Signals &_materialize() const;
+
+    // 持有信号的shared指针，emit时通过 shared_from_this 临时保护，避免直接被释放导致野指针
+    ::std::shared_ptr<Signals> _shared() const;
+
+    mutable SS_ATOMIC(Signals *) _s = nullptr;
+    mutable ::std::shared_ptr<Signals> _own;
+
+    friend class Signals;
+    friend class SignalBase;
+    friend class Dispatcher;
+    friend class TeardownScope;
+};
+
+// 批量析构的作用域，用于同时析构大量的对象，只在创建作用域的线程中生效，嵌套时合并到最外层
+// 标记的对象之间不再互相断开，存活对象断开的插槽在作用域结束时每个插槽列表只压缩一次
+// @note 标记的对象需要在作用域结束之前全部析构，期间不能再激发它们的信号
+class TeardownScope {
+public:
+
+    TeardownScope();
+
+    TeardownScope(TeardownScope const &) = delete;
+
+    TeardownScope &operator=(TeardownScope const &) = delete;
+
+    // 压缩存活对象的插槽列表
+    ~TeardownScope();
+
+    // 标记即将析构的对象
+    void doom(Object const *obj);
+
+    // 标记一组对象，元素为对象的指针或者智能指针
+    template<typename It>
+    void doom(It first, It last) {
+        for (; first != last; ++first) {
+            doom(&**first);
+        }
+    }
+
+private:
+
+    // 记录需要压缩的signals，不存在作用域时返回false
+    static bool _defer(Signals &sigs);
+
+    TeardownScope *_outer;
+
+    // 作用域编号，标记不需要逐个清除
+    uint64_t _gen;
+
+    ::std::unordered_map<Signals *, ::std::weak_ptr<Signals> > _dirty;
+
+    friend class Signals;
+    friend class Slots;
+};
+
+// 类型化信号的插槽，Connection 通过它断开或阻塞
+class TypedSlot {
+public:
+
+    // 回调函数归属的对象
+    Object *target = nullptr;
+
+    // 优先级，越大越先调用，相同优先级按照连接的顺序
+    int priority = 0;
+
+    // 只激发一次，激发后自动断开
+    bool once = false;
+
+protected:
+
+    // 是否在连接中，断开或者once插槽激发后为false
+    bool _isconnected() const {
+        return _connected && !(once && _emited);
+    }
+
+    // 连接状态，修改由所属signals的锁保护
+    SS_ATOMIC(bool) _connected = true;
+    SS_ATOMIC(bool) _blocked = false;
+
+    // once插槽的激发次数，多个线程同时激发时只有第一个调用
+    SS_ATOMIC(size_t) _emited = 0;
+
+    // 所属的signals和信号，用于通过 Connection 断开
+    ::std::weak_ptr<Signals> _owner;
+    SignalBase *_signal = nullptr;
+
+    friend class Connection;
+
+    template<typename... Args>
+    friend class Signal;
+};
+
+// 类型化信号的基类，注册到所属对象的Signals中，使得连接的对象析构时可以自动断开
+class SignalBase {
+public:
+
+    explicit SignalBase(Object *owner);
+
+    SignalBase(SignalBase const &) = delete;
+
+    SignalBase &operator=(SignalBase const &) = delete;
+
+    virtual ~SignalBase();
+
+    // 信号的主体，信号需要和主体同生命周期，一般作为主体的成员
+    attach_ptr<Object> owner;
+
+    // 断开连接到target的插槽
+    virtual bool disconnectOfTarget(Object *target) = 0;
+
+    // 是否存在连接到target的插槽
+    virtual bool isConnectedOfTarget(Object *target) const = 0;
+
+    // 清空连接
+    virtual void clear() = 0;
+
+protected:
+
+    // 锁住所属对象的Signals，Signals还没有创建时不加锁
+    lock_type _lock() const;
+
+    // 第一次连接时注册到所属对象的Signals中，返回持有的锁
+    lock_type _attach();
+
+    // 从所属对象的Signals中移除
+    void _detach();
+
+    // 建立反向连接，target析构时会自动断开和当前信号的连接
+    void _link(Object *target);
+
+    // 当前信号已经没有连接到target的插槽时，从所属对象的索引中移除 @note 需要持有锁
+    void _unlink(Object *target);
+
+    // 保护所属对象的Signals，避免emit过程中主体析构导致被释放
+    ::std::shared_ptr<Signals> _lifekeep() const;
+
+    // 通过 Connection 断开插槽，返回是否断开了连接 @note 需要持有锁
+    virtual bool _remove(TypedSlot &s) = 0;
+
+private:
+
+    // 是否已经注册到所属对象的Signals中，由Signals的锁保护
+    bool _attached = false;
+
+    friend class Connection;
+};
+
+// 类型化信号的参数，按照引用传递
+template<typename T>
+using signal_arg_t = typename ::std::add_lvalue_reference<typename ::std::add_const<T>::type>::type;
+
+// 类型化信号，参数类型在编译期检查，emit按照const引用转发参数给每个插槽，不复制也不分配内存，插槽按值接收的参数在调用时复制
+template<typename... Args>
+class Signal : public SignalBase {
+public:
+
+    typedef void (*pfn_callback_type)(Args...);
+
+    typedef void (Object::*pfn_membercallback_type)(Args...);
+
+    // 函数对象通过返回的 Connection 断开，参数按照引用传入，插槽按值接收时才复制
+    typedef Delegate<void(signal_arg_t<Args>...)> callback_type;
+
+    explicit Signal(Object *owner)
+        : SignalBase(owner) {}
+
+    virtual ~Signal() {
+        // 在同一个锁内清空并移除，避免析构过程中被其他线程的disconnectOfTarget访问到
+        auto lck = _lock();
+        clear();
+        _detach();
+    }
+
+    // 连接函数对象，@priority 越大越先调用
+    Connection connect(callback_type cb, int priority = 0);
+
+    // 连接普通函数，已经连接则返回空的连接
+    Connection connect(pfn_callback_type cb, int priority = 0);
+
+    // 连接成员函数，已经连接则返回空的连接
+    template<typename C>
+    Connection connect(void (C::*cb)(Args...), C *target, int priority = 0);
+
+    // 连接只激发一次的函数对象
+    Connection once(callback_type cb, int priority = 0);
+
+    // 连接只激发一次的普通函数，已经连接则返回空的连接
+    Connection once(pfn_callback_type cb, int priority = 0);
+
+    // 连接只激发一次的成员函数，已经连接则返回空的连接
+    template<typename C>
+    Connection once(void (C::*cb)(Args...), C *target, int priority = 0);
+
+    // 断开普通函数
+    bool disconnect(pfn_callback_type cb);
+
+    // 断开成员函数
+    template<typename C>
+    bool disconnect(void (C::*cb)(Args...), C *target);
+
+    // 是否存在连接
+    bool isConnected() const;
+
+    // 已经连接的插槽数量
+    size_t size() const;
+
+    // 激发信号
+    void emit(signal_arg_t<Args>... args) const;
+
+    virtual bool disconnectOfTarget(Object *target) override;
+
+    virtual bool isConnectedOfTarget(Object *target) const override;
+
+    virtual void clear() override;
+
+protected:
+
+    virtual bool _remove(TypedSlot &s) override;
+
+private:
+
+    struct slot_type : TypedSlot {
+        callback_type cb;
+    };
+
+    // 按值接收参数的普通函数和成员函数，保存在 callback_type 中转发引用，可以比较，用于查重和断开
+    struct Function {
+        pfn_callback_type fn;
+
+        void operator()(signal_arg_t<Args>... args) const {
+            fn(args...);
+        }
+
+        bool operator==(Function const &r) const {
+            return fn == r.fn;
+        }
+    };
+
+    struct Member {
+        pfn_membercallback_type fn;
+        Object *target;
+
+        void operator()(signal_arg_t<Args>... args) const {
+            (target->*fn)(args...);
+        }
+
+        bool operator==(Member const &r) const {
+            return fn == r.fn && target == r.target;
+        }
+    };
+
+    typedef ::std::vector<::std::shared_ptr<slot_type> > slots_type;
+
+    // 插入到同一优先级的末尾
+    static void _insert(slots_type &ss, ::std::shared_ptr<slot_type> s);
+
+    // 添加插槽，@dedup 为true时已经存在相同的插槽则返回空的连接
+    Connection _add(callback_type cb, Object *target, int priority, bool once, bool dedup);
+
+    // 断开满足条件的插槽，返回是否断开了连接 @note 需要持有锁
+    template<typename P>
+    bool _disconnect(P pred);
+
+    // 重建列表，移除已经断开的插槽 @note 需要持有锁
+    void _compact();
+
+    // 移除已经激发的once插槽
+    void _expire();
+
+    // 和Slots相同，emit直接读取当前列表，修改时如果正在emit则复制一份
+    CowPtr<slots_type> _slots;
+
+    // 已经断开但是还在列表中的插槽数，超过一半时重建列表，由锁保护
+    size_t _dead = 0;
+};
+
+template<typename... Args>
+inline void Signal<Args...>::_insert(slots_type &ss, ::std::shared_ptr<slot_type> s) {
+    auto pos = ss.end();
+    if (!ss.empty() && ss.back()->priority < s->priority) {
+        pos = ::std::upper_bound(ss.begin(), ss.end(), s->priority, [](int priority, ::std::shared_ptr<slot_type> const &r) {
+            return priority > r->priority;
+        });
+    }
+    ss.emplace(pos, ::std::move(s));
+}
+
+template<typename... Args>
+inline Connection Signal<Args...>::_add(callback_type cb, Object *target, int priority, bool once, bool dedup) {
+    auto lck = _attach();
+    if (dedup) {
+        auto snaps = _slots.read();
+        if (snaps) {
+            for (auto &s : *snaps) {
+                if (s->_isconnected() && s->cb == cb)
+                    return Connection();
+            }
+        }
+    }
+
+    auto s = ::std::make_shared<slot_type>();
+    s->cb = ::std::move(cb);
+    s->target = target;
+    s->priority = priority;
+    s->once = once;
+    s->_owner = _lifekeep();
+    s->_signal = this;
+    _slots.write([&](slots_type &ss) {
+        _insert(ss, s);
+    });
+    if (target)
+        _link(target);
+    return Connection(::std::move(s));
+}
+
+template<typename... Args>
+inline Connection Signal<Args...>::connect(callback_type cb, int priority) {
+    return _add(::std::move(cb), nullptr, priority, false, false);
+}
+
+template<typename... Args>
+inline Connection Signal<Args...>::connect(pfn_callback_type cb, int priority) {
+    if (!cb)
+        return Connection();
+    return _add(Function{cb}, nullptr, priority, false, true);
+}
+
+template<typename... Args>
+template<typename C>
+inline Connection Signal<Args...>::connect(void (C::*cb)(Args...), C *target, int priority) {
+    static_assert(::std::is_base_of<Object, C>::value, "插槽对象必须继承于 Object");
+    if (!cb || !target)
+        return Connection();
+    return _add(Member{static_cast<pfn_membercallback_type>(cb), target}, target, priority, false, true);
+}
+
+template<typename... Args>
+inline Connection Signal<Args...>::once(callback_type cb, int priority) {
+    return _add(::std::move(cb), nullptr, priority, true, false);
+}
+
+template<typename... Args>
+inline Connection Signal<Args...>::once(pfn_callback_type cb, int priority) {
+    if (!cb)
+        return Connection();
+    return _add(Function{cb}, nullptr, priority, true, true);
+}
+
+template<typename... Args>
+template<typename C>
+inline Connection Signal<Args...>::once(void (C::*cb)(Args...), C *target, int priority) {
+    static_assert(::std::is_base_of<Object, C>::value, "插槽对象必须继承于 Object");
+    if (!cb || !target)
+        return Connection();
+    return _add(Member{static_cast<pfn_membercallback_type>(cb), target}, target, priority, true, true);
+}
+
+template<typename... Args>
+template<typename P>
+inline bool Signal<Args...>::_disconnect(P pred) {
+    SmallSet<Object *, 8> targets;
+    bool r = false;
+    {
+        auto snaps = _slots.read();
+        if (!snaps)
+            return false;
+        for (auto &s : *snaps) {
+            if (s->_connected && pred(*s)) {
+                s->_connected = false;
+                if (s->target)
+                    targets.insert(s->target);
+                r = true;
+            }
+        }
+    }
+    if (!r)
+        return false;
+
+    _compact();
+    for (auto &target : targets) {
+        _unlink(target);
+    }
+    return true;
+}
+
+template<typename... Args>
+inline void Signal<Args...>::_compact() {
+    _slots.write([](slots_type &ss) {
+        ss.erase(::std::remove_if(ss.begin(), ss.end(), [](::std::shared_ptr<slot_type> const &s) {
+            return !s->_connected;
+        }), ss.end());
+    });
+    _dead = 0;
+}
+
+template<typename... Args>
+inline bool Signal<Args...>::_remove(TypedSlot &s) {
+    if (!s._connected)
+        return false;
+
+    // 标记为断开，emit会跳过，断开的插槽累计超过一半时再重建列表，使断开的均摊开销为O(1)
+    s._connected = false;
+    if (s.target)
+        _unlink(s.target);
+
+    bool compact;
+    {
+        auto snaps = _slots.read();
+        compact = snaps && ++_dead * 2 > snaps->size();
+    }
+    if (compact)
+        _compact();
+    return true;
+}
+
+template<typename... Args>
+inline void Signal<Args...>::_expire() {
+    auto lck = _lock();
+    ::std::vector<TypedSlot *> expired;
+    {
+        auto snaps = _slots.read();
+        if (!snaps)
+            return;
+        for (auto &s : *snaps) {
+            if (s->_connected && s->once && s->_emited)
+                expired.emplace_back(s.get());
+        }
+    }
+    // 列表重建后插槽依旧由Connection或者旧的列表持有
+    for (auto s : expired) {
+        _remove(*s);
+    }
+}
+
+template<typename... Args>
+inline bool Signal<Args...>::disconnect(pfn_callback_type cb) {
+    auto lck = _lock();
+    return cb && _disconnect([=](slot_type const &s) {
+        return s.cb == callback_type(Function{cb});
+    });
+}
+
+template<typename... Args>
+template<typename C>
+inline bool Signal<Args...>::disconnect(void (C::*cb)(Args...), C *target) {
+    auto memcb = static_cast<pfn_membercallback_type>(cb);
+    auto lck = _lock();
+    return _disconnect([=](slot_type const &s) {
+        return s.target != nullptr && s.target == target && s.cb == callback_type(Member{memcb, target});
+    });
+}
+
+template<typename... Args>
+inline bool Signal<Args...>::isConnected() const {
+    return size() != 0;
+}
+
+template<typename... Args>
+inline size_t Signal<Args...>::size() const {
+    auto snaps = _slots.read();
+    if (!snaps)
+        return 0;
+    return ::std::count_if(snaps->begin(), snaps->end(), [](::std::shared_ptr<slot_type> const &s) {
+        return s->_isconnected();
+    });
+}
+
+template<typename... Args>
+inline void Signal<Args...>::emit(signal_arg_t<Args>... args) const {
+    bool expired = false;
+    {
+        auto snaps = _slots.read();
+        if (!snaps || snaps->empty())
+            return;
+
+        auto lifekeep = _lifekeep();
+        for (auto &s : *snaps) {
+            if (!s->_connected || s->_blocked)
+                continue;
+            if (s->once) {
+                // 多个线程同时激发时只有第一个调用
+                if (s->_emited++)
+                    continue;
+                expired = true;
+            }
+
+            s->cb(args...);
+
+            if (!lifekeep->owner) {
+                // 如果运行过程中根对象已经析构，则停止执行
+                return;
+            }
+        }
+    }
+
+    if (expired) {
+        // 断开已经激发的once插槽
+        const_cast<Signal *>(this)->_expire();
+    }
+}
+
+template<typename... Args>
+inline bool Signal<Args...>::disconnectOfTarget(Object *target) {
+    auto lck = _lock();
+    return target && _disconnect([=](slot_type const &s) {
+        return s.target == target;
+    });
+}
+
+template<typename... Args>
+inline bool Signal<Args...>::isConnectedOfTarget(Object *target) const {
+    auto snaps = _slots.read();
+    if (!snaps)
+        return false;
+    for (auto &s : *snaps) {
+        if (s->target == target && s->_isconnected())
+            return true;
+    }
+    return false;
+}
+
+template<typename... Args>
+inline void Signal<Args...>::clear() {
+    auto lck = _lock();
+    SmallSet<Object *, 8> targets;
+    {
+        auto snaps = _slots.read();
+        if (!snaps)
+            return;
+        for (auto &s : *snaps) {
+            // Connection 持有锁时看到插槽依旧连接，说明信号还没有析构
+            s->_connected = false;
+            if (s->target)
+                targets.insert(s->target);
+        }
+    }
+    _slots.reset();
+    _dead = 0;
+    for (auto &target : targets) {
+        _unlink(target);
+    }
+}
+
 #define SS_SIGNAL(sig) static const ::SS_NS::signal_t sig;
-#define SS_SIGNAL_IMPL(sig, val) const ::SS_NS::signal_t sig = val;
+#define SS_SIGNAL_IMPL(sig, val) const ::SS_NS::signal_t sig = ::SS_NS::SignalNames::intern(val);
+
+// 在类的public中编译期声明信号，例如 SS_SIGNALS(clicked, pressed)，之后通过 Button::Sig::clicked 连接和激发
+// 不需要 registerr，第一次连接时按照信号数量创建定长的插槽表，通过名称访问需要在插槽表创建之后
+// 没有连接过的对象通过 Object::emit 激发时不会创建Signals，signals().emit 会先创建Signals
+#define SS_SIGNALS(...) \
+    enum struct Sig : unsigned { __VA_ARGS__ }; \
+    static constexpr unsigned SIGNAL_COUNT = ::SS_NS::SignalClass::count(#__VA_ARGS__); \
+    static constexpr ::std::array<::std::string_view, SIGNAL_COUNT> _signalNames = \
+        ::SS_NS::SignalClass::split<SIGNAL_COUNT>(#__VA_ARGS__); \
+    static inline ::SS_NS::signal_t _signalIds[SIGNAL_COUNT] = {}; \
+    static inline ::SS_NS::SignalClass const _signalClass{_signalNames.data(), SIGNAL_COUNT, _signalIds}; \
+    static ::SS_NS::SignalClass const &signalClass() { return _signalClass; } \
+    friend ::SS_NS::SignalClass const &ssSignalClass(Sig) { return _signalClass; }
 
 SS_END
@@ -1,8 +1,19 @@
 ﻿#include "../src/signals.hpp"
+#include <array>
+#include <fstream>
+#include <numeric>
 
 USE_SS;
 using namespace std;
 
+static int failures = 0;
+
+static void fail(char const *msg)
+{
+    cerr << msg << endl;
+    ++failures;
+}
+
 class A : public Object {
 public:
 
@@ -89,7 +100,7 @@ void test2()
     a.signals().once("a", [&](Slot&s) {});
     a.signals().emit("a");
     if (a.signals().find("a")->size() != 0) {
-        cerr << "按照次数进行连接的模块存在bug" << endl;
+        fail("按照次数进行连接的模块存在bug");
     }
 }
 
@@ -105,10 +116,1101 @@ void test3()
     a.signals().emit("a");
 }
 
+class D : public Object {
+public:
+
+    SS_SIGNAL(SIG_CHANGED)
+
+    D() {
+        signals().registerr(SIG_CHANGED);
+    }
+};
+
+SS_SIGNAL_IMPL(D::SIG_CHANGED, "changed")
+
+void test4()
+{
+    // 测试信号id和信号名称两种方式等价
+    D d;
+    int cnt = 0;
+    d.signals().connect(D::SIG_CHANGED, [&](Slot &) {
+        ++cnt;
+        });
+    d.signals().emit(D::SIG_CHANGED);
+    d.signals().emit("changed");
+    if (cnt != 2 || SignalNames::find("changed") != D::SIG_CHANGED) {
+        fail("信号id的映射存在bug");
+    }
+
+    // 名称索引扩容后之前分配的id依旧可以查到
+    vector<signal_t> ids;
+    for (int i = 0; i < 200; ++i) {
+        ids.push_back(SignalNames::intern("names." + to_string(i)));
+    }
+    for (int i = 0; i < 200; ++i) {
+        string name = "names." + to_string(i);
+        if (SignalNames::find(name) != ids[i] || SignalNames::name(ids[i]) != name) {
+            fail("信号id的映射存在bug");
+        }
+    }
+    if (SignalNames::find("changed") != D::SIG_CHANGED || SignalNames::find("names.x") != 0 || SignalNames::find("") != 0) {
+        fail("信号id的映射存在bug");
+    }
+}
+
+static int counter = 0;
+
+void count(Slot &)
+{
+    ++counter;
+}
+
+void test5()
+{
+    // 测试emit过程中修改插槽，当前emit依旧使用修改前的插槽列表
+    A a;
+    a.signals().registerr("a");
+    int cnt = 0;
+    a.signals().connect("a", [&](Slot &) {
+        a.signals().connect("a", [&](Slot &) {
+            ++cnt;
+            });
+        a.signals().disconnect("a", count);
+        });
+    a.signals().connect("a", count);
+    a.signals().emit("a");
+    if (cnt != 0 || counter != 1) {
+        fail("emit过程中修改插槽存在bug");
+    }
+    a.signals().emit("a");
+    if (cnt != 1 || counter != 1) {
+        fail("emit过程中修改插槽存在bug");
+    }
+}
+
+class Sensor : public Object {
+public:
+
+    Signal<int, string> changed{this};
+};
+
+class Display : public Object {
+public:
+
+    void onChanged(int v, string name) {
+        value += v;
+        this->name = name;
+    }
+
+    int value = 0;
+    string name;
+};
+
+static int sensorValue = 0;
+
+void onSensorChanged(int v, string)
+{
+    sensorValue += v;
+}
+
+// 记录复制次数的参数
+struct Tracked {
+    Tracked() = default;
+
+    Tracked(Tracked const &r)
+        : value(r.value), text(r.text) {
+        ++copies;
+    }
+
+    int value = 0;
+    string text = string(64, 'x');
+
+    static int copies;
+};
+
+int Tracked::copies = 0;
+
+class Probe : public Object {
+public:
+
+    Signal<Tracked> sent{this};
+};
+
+static int trackedValue = 0;
+
+void onTracked(Tracked const &t)
+{
+    trackedValue += t.value;
+}
+
+void test6()
+{
+    // 测试类型化信号，以及连接对象析构后的自动断开
+    Sensor sensor;
+    int cnt = 0;
+    sensor.changed.connect([&](int v, string const &) {
+        cnt += v;
+        });
+    sensor.changed.connect(onSensorChanged);
+    {
+        Display display;
+        sensor.changed.connect(&Display::onChanged, &display);
+        sensor.changed.emit(1, "a");
+        if (display.value != 1 || display.name != "a") {
+            fail("类型化信号存在bug");
+        }
+    }
+    sensor.changed.emit(2, "b");
+    if (cnt != 3 || sensorValue != 3 || sensor.changed.size() != 2) {
+        fail("类型化信号存在bug");
+    }
+
+    {
+        // 信号对象先于连接对象析构
+        Display display;
+        {
+            Sensor tmp;
+            tmp.changed.connect(&Display::onChanged, &display);
+        }
+    }
+
+    // 参数按照引用转发给每个插槽，不复制
+    Probe probe;
+    int got = 0;
+    probe.sent.connect([&](Tracked const &t) {
+        got += t.value;
+        });
+    probe.sent.connect([&](Tracked const &t) {
+        got += t.value;
+        });
+    probe.sent.connect(onTracked);
+    Tracked t;
+    t.value = 1;
+    Tracked::copies = 0;
+    probe.sent.emit(t);
+    if (got != 2 || trackedValue != 1 || Tracked::copies != 0) {
+        fail("类型化信号的参数存在复制");
+    }
+}
+
+void test7()
+{
+    // 测试队列连接，插槽在dispatcher执行时才被调用，目标析构后不再调用
+    A a;
+    a.signals().registerr("a");
+    Dispatcher dispatcher;
+    int cnt = 0;
+    a.signals().connect("a", [&](Slot &s) {
+        cnt += s.data->toInt();
+        }, dispatcher);
+    {
+        B b;
+        a.signals().connect("a", &B::proc, &b, dispatcher);
+        a.signals().emit("a", com::_V(2));
+    }
+    a.signals().emit("a", com::_V(3));
+    if (cnt != 0) {
+        fail("队列连接存在bug");
+    }
+    if (dispatcher.poll() != 3 || cnt != 5) {
+        fail("队列连接存在bug");
+    }
+
+    // 投递之后断开或者阻塞的插槽在dispatcher执行时跳过
+    int queued = 0;
+    Connection conn = a.signals().connect("a", [&](Slot &) {
+        ++queued;
+        }, dispatcher);
+    a.signals().emit("a", com::_V(1));
+    conn.disconnect();
+    conn = a.signals().connect("a", [&](Slot &) {
+        ++queued;
+        }, dispatcher);
+    a.signals().emit("a", com::_V(1));
+    conn.block();
+    dispatcher.poll();
+    conn.unblock();
+    if (queued != 0 || cnt != 7) {
+        fail("队列连接存在bug");
+    }
+}
+
+void test8()
+{
+    // 测试arena分配的插槽，arena析构后插槽依旧可用
+    A a;
+    Slots::slot_type s;
+    int cnt = 0;
+    {
+        ArenaAllocator arena;
+        AllocatorScope scope(arena);
+        a.signals().registerr("a");
+        s = a.signals().connect("a", [&](Slot &) {
+            ++cnt;
+            });
+    }
+    a.signals().connect("a", count);
+    a.signals().emit("a");
+    if (cnt != 1 || !s || s->count != 0 || a.signals().find("a")->size() != 2) {
+        fail("插槽分配器存在bug");
+    }
+}
+
+void test9()
+{
+    // 测试lambda插槽的断开，以及超过内部缓冲的函数对象
+    A a;
+    a.signals().registerr("a");
+    int cnt = 0;
+    auto f = [&](Slot &) {
+        ++cnt;
+    };
+    a.signals().connect("a", f);
+    a.signals().connect("a", f);
+    array<int, 32> big{1};
+    a.signals().connect("a", [&cnt, big](Slot &) {
+        cnt += big[0];
+        });
+    a.signals().emit("a");
+    a.signals().disconnect("a", f);
+    a.signals().emit("a");
+    if (cnt != 4 || a.signals().find("a")->size() != 1) {
+        fail("lambda插槽断开存在bug");
+    }
+}
+
+void test10()
+{
+    // 测试连接句柄的断开、阻塞，以及ScopedConnection
+    Connection conn;
+    {
+        A a;
+        a.signals().registerr("a");
+        int cnt = 0;
+        conn = a.signals().connect("a", [&](Slot &) {
+            ++cnt;
+            });
+        {
+            ScopedConnection scoped = a.signals().connect("a", [&](Slot &) {
+                cnt += 10;
+                });
+            a.signals().emit("a");
+        }
+        conn.block();
+        a.signals().emit("a");
+        conn.unblock();
+        a.signals().emit("a");
+        if (cnt != 12 || !conn.connected() || conn.blocked() || a.signals().find("a")->size() != 1) {
+            fail("连接句柄存在bug");
+        }
+        if (!conn.disconnect() || conn.disconnect() || conn.connected()) {
+            fail("连接句柄存在bug");
+        }
+        a.signals().emit("a");
+        if (cnt != 12 || a.signals().isConnected("a")) {
+            fail("连接句柄存在bug");
+        }
+        conn = a.signals().connect("a", count);
+    }
+    // 信号对象已经析构
+    if (conn.connected() || conn.disconnect()) {
+        fail("连接句柄存在bug");
+    }
+
+    // 类型化信号的函数对象也可以通过句柄断开
+    {
+        Sensor sensor;
+        int cnt = 0;
+        conn = sensor.changed.connect([&](int v, string const &) {
+            cnt += v;
+            });
+        {
+            ScopedConnection scoped = sensor.changed.connect([&](int v, string const &) {
+                cnt += v * 10;
+                });
+            sensor.changed.emit(1, "a");
+        }
+        conn.block();
+        sensor.changed.emit(1, "a");
+        if (cnt != 11 || !conn.connected() || !conn.blocked() || sensor.changed.size() != 1) {
+            fail("类型化信号的连接句柄存在bug");
+        }
+        conn.unblock();
+        if (!conn.disconnect() || conn.disconnect() || conn.connected() || sensor.changed.isConnected()) {
+            fail("类型化信号的连接句柄存在bug");
+        }
+
+        // 重复连接的普通函数返回空的连接，once插槽激发后自动断开
+        Display display;
+        if (!sensor.changed.connect(onSensorChanged) || sensor.changed.connect(onSensorChanged)) {
+            fail("类型化信号的连接句柄存在bug");
+        }
+        sensor.changed.disconnect(onSensorChanged);
+        conn = sensor.changed.once(&Display::onChanged, &display);
+        sensor.changed.emit(2, "b");
+        sensor.changed.emit(3, "c");
+        if (display.value != 2 || conn.connected() || sensor.changed.isConnected() ||
+            sensor.signals().isConnectedOfTarget(&display)) {
+            fail("类型化信号的once存在bug");
+        }
+        conn = sensor.changed.connect([&](int v, string const &) {
+            cnt += v;
+            });
+    }
+    if (conn.connected() || conn.disconnect()) {
+        fail("类型化信号的连接句柄存在bug");
+    }
+}
+
+class Hub : public Object {
+public:
+
+    Hub() {
+        signals().registerr("a");
+        signals().registerr("b");
+    }
+
+    Signal<int, string> changed{this};
+};
+
+void test11()
+{
+    // 测试按照连接对象的索引，动态信号和类型化信号混合连接
+    Hub hub;
+    Display display;
+    B b;
+    hub.signals().connect("a", &B::proc, &b);
+    hub.signals().connect("b", &B::proc, &b);
+    hub.changed.connect(&Display::onChanged, &display);
+    hub.signals().disconnect("a", (Slot::pfn_membercallback_type)&B::proc, &b);
+    if (!hub.signals().isConnectedOfTarget(&b) || !hub.signals().isConnectedOfTarget(&display)) {
+        fail("连接对象的索引存在bug");
+    }
+    hub.signals().disconnectOfTarget(&b);
+    hub.signals().disconnectOfTarget(&display);
+    hub.changed.emit(1, "a");
+    if (hub.signals().isConnectedOfTarget(&b) || hub.signals().isConnectedOfTarget(&display) ||
+        hub.signals().isConnected("b") || hub.changed.isConnected() || display.value != 0) {
+        fail("连接对象的索引存在bug");
+    }
+    hub.changed.connect(&Display::onChanged, &display);
+    hub.changed.disconnect(&Display::onChanged, &display);
+    if (hub.signals().isConnectedOfTarget(&display)) {
+        fail("连接对象的索引存在bug");
+    }
+}
+
+void test12()
+{
+    // 测试批量激发，中断和激发次数按照每个数据计算
+    for (auto order : {EmitOrder::PAYLOAD_MAJOR, EmitOrder::SLOT_MAJOR}) {
+        A a;
+        a.signals().registerr("a");
+        int onced = 0, sum = 0, after = 0;
+        a.signals().once("a", [&](Slot &s) {
+            onced += s.data->toInt();
+            });
+        a.signals().connect("a", [&](Slot &s) {
+            sum += s.data->toInt();
+            // 偶数中断
+            s.setVeto(s.data->toInt() % 2 == 0);
+            });
+        a.signals().connect("a", [&](Slot &s) {
+            after += s.data->toInt();
+            });
+        vector<Slot::data_type> payloads{com::_V(1), com::_V(2), com::_V(3)};
+        a.signals().emitBatch("a", payloads, order);
+        if (onced != 1 || sum != 6 || after != 4 || a.signals().find("a")->size() != 2) {
+            fail("批量激发存在bug");
+        }
+    }
+}
+
+void test13()
+{
+    // 测试节流的尾部调用、防抖以及延迟激发，时间轮推进时才调用
+    A a;
+    a.signals().registerr("a");
+    TimerWheel wheel;
+    int throttled = 0, last = 0, debounced = 0, delayed = 0;
+    a.signals().connect("a", [&](Slot &s) {
+        ++throttled;
+        last = s.data->toInt();
+        }).throttle(10, wheel);
+    a.signals().connect("a", [&](Slot &s) {
+        debounced += s.data->toInt();
+        }).debounce(50, wheel);
+    a.signals().connect("a", [&](Slot &s) {
+        delayed += s.data->toInt();
+        }).delay(20, wheel);
+    for (int i = 1; i <= 3; ++i) {
+        a.signals().emit("a", com::_V(i));
+    }
+    if (throttled != 1 || last != 1 || debounced != 0 || delayed != 0 || wheel.size() != 5) {
+        fail("定时激发存在bug");
+    }
+    wheel.advance(TimerWheel::now() + 30);
+    if (delayed != 6 || debounced != 0) {
+        fail("定时激发存在bug");
+    }
+    wheel.advance(TimerWheel::now() + 1000);
+    if (throttled != 2 || last != 3 || debounced != 3 || wheel.size() != 0) {
+        fail("定时激发存在bug");
+    }
+
+    // 对象析构后等待中的任务不再调用
+    {
+        A b;
+        b.signals().registerr("b");
+        b.signals().connect("b", [&](Slot &) {
+            ++delayed;
+            }).delay(10, wheel);
+        b.signals().emit("b");
+    }
+    wheel.advance(TimerWheel::now() + 1000);
+    if (delayed != 6) {
+        fail("定时激发存在bug");
+    }
+}
+
+void test14()
+{
+    // 测试插槽优先级，同一优先级按照连接顺序，高优先级中断后低优先级不再调用
+    A a;
+    a.signals().registerr("a");
+    string order;
+    a.signals().connect("a", [&](Slot &) {
+        order += "l";
+        }, -1);
+    a.signals().connect("a", [&](Slot &) {
+        order += "0";
+        });
+    a.signals().connect("a", [&](Slot &s) {
+        order += "h";
+        s.setVeto(s.data && s.data->toInt() == 1);
+        }, 10);
+    a.signals().once("a", [&](Slot &) {
+        order += "1";
+        });
+    a.signals().once("a", [&](Slot &) {
+        order += "H";
+        }, 10);
+    a.signals().emit("a");
+    a.signals().emit("a", com::_V(1));
+    if (order != "hH01lh") {
+        fail("插槽优先级存在bug");
+    }
+
+    Sensor sensor;
+    order.clear();
+    sensor.changed.connect([&](int, string const &) {
+        order += "0";
+        });
+    sensor.changed.connect([&](int, string const &) {
+        order += "h";
+        }, 1);
+    sensor.changed.emit(0, "");
+    if (order != "h0") {
+        fail("插槽优先级存在bug");
+    }
+}
+
+void test15()
+{
+    // 测试Variant保存字符串和字节，移动以及跨类型赋值
+    typedef com::Variant<> variant_t;
+    variant_t a(string(64, 'x'));
+    auto data = a.toString().data();
+    variant_t b(move(a));
+    if (b.type() != variant_t::VT::STRING || b.toString().data() != data) {
+        fail("Variant移动存在bug");
+    }
+    variant_t c(1);
+    c = b;
+    b = variant_t(variant_t::bytes_type{1, 2, 3});
+    if (c.toString() != string(64, 'x') || b.type() != variant_t::VT::BYTES || b.toBytes().size() != 3) {
+        fail("Variant赋值存在bug");
+    }
+    c = move(b);
+    b = "short";
+    if (c.toBytes()[2] != 3 || b.toString() != "short") {
+        fail("Variant赋值存在bug");
+    }
+}
+
+void test16()
+{
+    // 测试外部缓冲，激发时插槽直接访问原始内存，不复制数据
+    A a;
+    a.signals().registerr("a");
+    auto frame = make_shared<vector<unsigned char> >(1 << 20, 7);
+    unsigned char const *seen = nullptr;
+    a.signals().connect("a", [&](Slot &s) {
+        auto view = s.data->toView();
+        if (view.size() == frame->size() && view[100] == 7)
+            seen = view.data();
+        });
+    a.signals().emit("a", com::_V(com::Buffer(frame)));
+    if (seen != frame->data() || frame.use_count() != 1) {
+        fail("外部缓冲存在bug");
+    }
+
+    // 其他类型的访问返回空，不读取联合体中无效的成员
+    com::Variant<> buffered{com::Buffer(frame)};
+    if (!buffered.toBytes().empty() || !buffered.toString().empty() || buffered.toView().size() != frame->size()) {
+        fail("外部缓冲存在bug");
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    {
+        ofstream out("ss_buffer_test.bin", ios::binary);
+        out << "mapped";
+    }
+    com::Variant<> mapped(com::Buffer::map("ss_buffer_test.bin"));
+    remove("ss_buffer_test.bin");
+    auto view = mapped.toView();
+    if (mapped.type() != com::Variant<>::VT::BUFFER || string(view.begin(), view.end()) != "mapped" ||
+        mapped.toBuffer().data() != view.data()) {
+        fail("外部缓冲存在bug");
+    }
+#endif
+}
+
+void test17()
+{
+    // 测试栈上的激发上下文以及合并插槽的结果
+    A a;
+    a.signals().registerr("a");
+    int called = 0;
+    a.signals().connect("a", [&](Slot &s) {
+        ++called;
+        s.setResult(nullptr);
+        });
+    a.signals().connect("a", [&](Slot &s) {
+        ++called;
+        s.setResult(2);
+        });
+    a.signals().connect("a", [&](Slot &s) {
+        ++called;
+        s.setResult(0.5);
+        s.setVeto(s.data && s.data->toBool());
+        });
+    a.signals().connect("a", [&](Slot &s) {
+        ++called;
+        s.setResult(string("last"));
+        });
+
+    FirstNotNullCombiner first;
+    EmitContext ctx1(first);
+    a.signals().emit("a", ctx1);
+    if (called != 2 || first.result.toInt() != 2 || !ctx1.getVeto()) {
+        fail("插槽结果合并存在bug");
+    }
+
+    SumCombiner<double> sum;
+    EmitContext ctx2(sum);
+    a.signals().emit("a", ctx2, com::_V(true));
+    if (called != 5 || sum.result != 2.5 || !ctx2.getVeto()) {
+        fail("插槽结果合并存在bug");
+    }
+
+    // 第一个结果为空，视为假，立即中断
+    AllTrueCombiner all;
+    EmitContext ctx3(all);
+    a.signals().emit("a", ctx3);
+    if (called != 6 || all.result || !ctx3.getVeto()) {
+        fail("插槽结果合并存在bug");
+    }
+
+    com::Variant<> buf[2];
+    CollectCombiner collect(buf);
+    EmitContext ctx4(collect);
+    a.signals().emit("a", ctx4);
+    if (called != 10 || collect.count() != 4 || collect.size() != 2 || buf[1].toInt() != 2) {
+        fail("插槽结果合并存在bug");
+    }
+
+    // 没有 combiner 的上下文只记录中断
+    EmitContext ctx5;
+    a.signals().emit("a", ctx5, com::_V(true));
+    if (called != 13 || !ctx5.getVeto()) {
+        fail("插槽结果合并存在bug");
+    }
+}
+
+void test18()
+{
+    // 测试信号延迟创建，没有使用过信号的对象不创建Signals
+    Sensor sensor;
+    Display display;
+    if (sensor.hasSignals() || display.hasSignals()) {
+        fail("信号延迟创建存在bug");
+    }
+    sensor.changed.emit(1, "a");
+    if (sensor.hasSignals()) {
+        fail("信号延迟创建存在bug");
+    }
+
+    // 连接时创建双方的Signals
+    sensor.changed.connect(&Display::onChanged, &display);
+    sensor.changed.emit(1, "a");
+    if (!sensor.hasSignals() || !display.hasSignals() || display.value != 1) {
+        fail("信号延迟创建存在bug");
+    }
+
+    // 注册了但是没有连接的信号可以正常激发和查询
+    A a;
+    a.signals().registerr("a");
+    a.signals().emit("a");
+    a.signals().block("a");
+    if (a.signals().isConnected("a") || !a.signals().isblocked("a") || !a.signals().find("a")) {
+        fail("信号延迟创建存在bug");
+    }
+    a.signals().unblock("a");
+    int cnt = 0;
+    a.signals().connect("a", [&](Slot &) {
+        ++cnt;
+        });
+    a.signals().emit("a");
+    if (cnt != 1 || a.signals().find("a")->size() != 1) {
+        fail("信号延迟创建存在bug");
+    }
+}
+
+class Button : public Object {
+public:
+
+    SS_SIGNALS(clicked, pressed,
+               released)
+};
+
+static_assert(Button::SIGNAL_COUNT == 3 && Button::_signalNames[2] == "released", "编译期信号表存在bug");
+
+void test19()
+{
+    // 测试编译期声明的信号，不需要注册，按照索引访问插槽
+    Button button;
+    int clicked = 0, released = 0;
+
+    // 没有连接过的对象激发声明的信号，不创建Signals
+    button.emit(Button::Sig::clicked);
+    if (button.hasSignals()) {
+        fail("编译期信号表存在bug");
+    }
+    button.signals().emit(Button::Sig::clicked);
+    // 插槽表在第一次连接时才创建，之前通过名称无法访问
+    if (button.signals().isConnected(Button::Sig::clicked) || button.signals().find("released")) {
+        fail("编译期信号表存在bug");
+    }
+    button.signals().connect(Button::Sig::clicked, [&](Slot &s) {
+        if (s.signal == SignalNames::find("clicked"))
+            ++clicked;
+        });
+    button.signals().once(Button::Sig::released, [&](Slot &) {
+        ++released;
+        });
+    button.emit(Button::Sig::clicked);
+    button.signals().emit("clicked");
+    button.signals().emit(Button::Sig::released);
+    button.signals().emit(Button::Sig::released);
+    if (clicked != 2 || released != 1 || !button.signals().isConnected("clicked") ||
+        button.signals().isConnected(Button::Sig::released) || button.signals().registerr("pressed")) {
+        fail("编译期信号表存在bug");
+    }
+    button.signals().disconnect(Button::Sig::clicked);
+    button.signals().emit(Button::Sig::clicked);
+    if (clicked != 2) {
+        fail("编译期信号表存在bug");
+    }
+}
+
+void test20()
+{
+    // 测试线程池和并发插槽，单线程模式下并发插槽依旧顺序执行
+    ThreadPool pool(3);
+    ::std::atomic<size_t> sum{0};
+    pool.parallel(100, [&](size_t i) {
+        sum += i;
+        });
+    if (sum != 4950) {
+        fail("线程池存在bug");
+    }
+
+    A a;
+    a.signals().registerr("a");
+    ::std::atomic<int> concurrent{0};
+    int ordered = 0;
+    for (int i = 0; i < 4; ++i) {
+        a.signals().connect("a", [&, i](Slot &s) {
+            ++concurrent;
+            if (i == 0 && s.data->toInt() == 1)
+                s.setVeto(true);
+            }, 1).concurrent(pool);
+    }
+    a.signals().connect("a", [&](Slot &) {
+        ++ordered;
+        });
+
+    a.signals().emit("a", com::_V(0));
+    if (concurrent != 4 || ordered != 1) {
+        fail("并发插槽存在bug");
+    }
+
+    // 并发组中的中断在整组执行完之后生效
+    a.signals().emit("a", com::_V(1));
+    if (concurrent != 8 || ordered != 1) {
+        fail("并发插槽存在bug");
+    }
+}
+
+// 写入1到6，通道的容量为4
+static ::std::vector<int> fillChannel(Backpressure policy, size_t &dropped)
+{
+    A a;
+    a.signals().registerr("a");
+    Channel ch(4, policy);
+    a.signals().connect("a", ch);
+    for (int i = 1; i <= 6; ++i) {
+        a.signals().emit("a", com::_V(i));
+    }
+    a.signals().disconnect("a");
+    dropped = ch.dropped();
+
+    ::std::vector<int> r;
+    Slot::data_type buf[8];
+    for (size_t i = 0, n = ch.pop(buf, 8); i < n; ++i) {
+        r.push_back(buf[i]->toInt());
+    }
+    return r;
+}
+
+void test22()
+{
+    // 测试通道连接的溢出策略
+    size_t dropped;
+    if (fillChannel(Backpressure::DROP_NEWEST, dropped) != ::std::vector<int>({1, 2, 3, 4}) || dropped != 2) {
+        fail("通道连接存在bug");
+    }
+    if (fillChannel(Backpressure::DROP_OLDEST, dropped) != ::std::vector<int>({3, 4, 5, 6}) || dropped != 2) {
+        fail("通道连接存在bug");
+    }
+    if (fillChannel(Backpressure::COALESCE, dropped) != ::std::vector<int>({1, 2, 3, 4, 6}) || dropped != 1) {
+        fail("通道连接存在bug");
+    }
+
+    // 阻塞策略，消费者线程批量读取
+    A a;
+    a.signals().registerr("a");
+    Channel ch(8);
+    a.signals().connect("a", ch);
+    int sum = 0;
+    ::std::thread consumer([&]() {
+        Slot::data_type buf[16];
+        size_t n;
+        while ((n = ch.wait(buf, 16)) != 0) {
+            for (size_t i = 0; i < n; ++i) {
+                sum += buf[i]->toInt();
+            }
+        }
+    });
+    for (int i = 1; i <= 1000; ++i) {
+        a.signals().emit("a", com::_V(i));
+    }
+    ch.close();
+    consumer.join();
+    a.signals().emit("a", com::_V(1));
+    if (sum != 500500 || ch.dropped() != 0 || ch.capacity() != 8) {
+        fail("通道连接存在bug");
+    }
+}
+
+void test23()
+{
+    // 测试粘性信号，新的连接立即收到保留的数据
+    A a;
+    a.signals().registerr("state", 2);
+    a.signals().registerr("a");
+    for (int i = 1; i <= 3; ++i) {
+        a.signals().emit("state", com::_V(i));
+    }
+    ::std::vector<int> got;
+    a.signals().connect("state", [&](Slot &s) {
+        got.push_back(s.data->toInt());
+        });
+    if (got != ::std::vector<int>({2, 3}) || a.signals().find("state")->sticky() != 2) {
+        fail("粘性信号存在bug");
+    }
+    a.signals().emit("state", com::_V(4));
+    if (got != ::std::vector<int>({2, 3, 4})) {
+        fail("粘性信号存在bug");
+    }
+
+    // once 只收到保留的第一个数据
+    int onced = 0;
+    a.signals().once("state", [&](Slot &s) {
+        onced += s.data->toInt();
+        });
+    if (onced != 3 || a.signals().find("state")->size() != 1) {
+        fail("粘性信号存在bug");
+    }
+
+    // 阻塞期间的激发不保留
+    a.signals().block("state");
+    a.signals().emit("state", com::_V(5));
+    a.signals().unblock("state");
+    Channel ch(4);
+    a.signals().connect("state", ch);
+    Slot::data_type buf[4];
+    if (ch.pop(buf, 4) != 2 || buf[0]->toInt() != 3 || buf[1]->toInt() != 4) {
+        fail("粘性信号存在bug");
+    }
+    a.signals().disconnect("state");
+
+    // 普通信号不保留
+    a.signals().emit("a", com::_V(1));
+    int cnt = 0;
+    a.signals().connect("a", [&](Slot &) {
+        ++cnt;
+        });
+    if (cnt != 0 || a.signals().find("a")->sticky() != 0) {
+        fail("粘性信号存在bug");
+    }
+}
+
+class Counter : public Object {
+public:
+
+    void proc(Slot &) {
+        ++count;
+    }
+
+    void other(Slot &) {
+        ++count;
+    }
+
+    int count = 0;
+};
+
+void test24()
+{
+    // 测试按照连接对象索引的重复连接、断开以及析构
+    Object hub;
+    hub.signals().registerr("a");
+    hub.signals().registerr("b");
+    Counter keep;
+    ::std::vector<::std::unique_ptr<Counter> > spokes;
+    for (int i = 0; i < 100; ++i) {
+        spokes.emplace_back(new Counter());
+        hub.signals().connect("a", &Counter::proc, spokes.back().get());
+        hub.signals().connect("b", &Counter::proc, spokes.back().get());
+    }
+    hub.signals().connect("a", &Counter::proc, &keep);
+    hub.signals().connect("a", &Counter::proc, &keep);
+    hub.signals().connect("a", &Counter::other, &keep);
+    hub.signals().connect("b", &Counter::proc, &keep);
+    if (hub.signals().find("a")->size() != 102) {
+        fail("按照连接对象索引存在bug");
+    }
+
+    // 只断开 keep 在信号a上的一个回调
+    hub.signals().disconnect("a", (Slot::pfn_membercallback_type)&Counter::proc, &keep);
+    hub.signals().emit("a");
+    hub.signals().emit("b");
+    if (keep.count != 2 || spokes[0]->count != 2 || !hub.signals().isConnectedOfTarget(&keep)) {
+        fail("按照连接对象索引存在bug");
+    }
+
+    // 析构所有的监听者，只断开各自的连接
+    spokes.clear();
+    hub.signals().emit("a");
+    if (keep.count != 3 || hub.signals().find("a")->size() != 1 || hub.signals().find("b")->size() != 1) {
+        fail("按照连接对象索引存在bug");
+    }
+}
+
+void test25()
+{
+    // 测试批量析构，标记的对象之间不再断开，存活对象的插槽列表在作用域结束时压缩
+    Counter hub;
+    hub.signals().registerr("a");
+    Counter survivor;
+    hub.signals().connect("a", &Counter::proc, &survivor);
+
+    ::std::vector<::std::unique_ptr<Counter> > scene;
+    for (int i = 0; i < 50; ++i) {
+        scene.emplace_back(new Counter());
+        scene.back()->signals().registerr("a");
+        hub.signals().connect("a", &Counter::proc, scene.back().get());
+        scene.back()->signals().connect("a", &Counter::proc, &hub);
+        scene.back()->signals().connect("a", &Counter::proc, &survivor);
+    }
+    for (size_t i = 1; i < scene.size(); ++i) {
+        // 场景中的对象互相连接
+        scene[i]->signals().connect("a", &Counter::other, scene[i - 1].get());
+        scene[i - 1]->signals().connect("a", &Counter::other, scene[i].get());
+    }
+
+    {
+        TeardownScope scope;
+        scope.doom(scene.begin(), scene.end());
+        scene.clear();
+
+        // 断开的插槽在作用域结束之前只做标记，不会再调用
+        hub.signals().emit("a");
+        if (hub.signals().find("a")->size() != 1 || survivor.count != 1) {
+            fail("批量析构存在bug");
+        }
+    }
+
+    hub.signals().emit("a");
+    if (survivor.count != 2 || hub.count != 0 || hub.signals().isConnectedOfTarget(nullptr) ||
+        hub.signals().find("a")->size() != 1 || survivor.signals().isConnectedOfTarget(&hub)) {
+        fail("批量析构存在bug");
+    }
+}
+
+void test26()
+{
+    // 测试没有连接、阻塞以及只有一个插槽时的激发
+    Object hub;
+    hub.signals().registerr("a");
+    Counter c;
+    hub.signals().connect("a", &Counter::proc, &c);
+    hub.signals().emit("a");
+    hub.signals().disconnectOfTarget(&c);
+    hub.signals().emit("a");
+    if (c.count != 1 || hub.signals().find("a")->size() != 0) {
+        fail("激发快速路径存在bug");
+    }
+
+    // 断开之后重新连接
+    hub.signals().connect("a", &Counter::proc, &c);
+    hub.signals().block("a");
+    hub.signals().emit("a");
+    hub.signals().unblock("a");
+    hub.signals().emit("a");
+    if (c.count != 2) {
+        fail("激发快速路径存在bug");
+    }
+    hub.signals().disconnectOfTarget(&c);
+
+    // 唯一的插槽达到激活次数以及在调用中断开自己
+    hub.signals().once("a", &Counter::proc, &c);
+    hub.signals().emit("a");
+    hub.signals().emit("a");
+    Connection conn;
+    conn = hub.signals().connect("a", [&](Slot &) {
+        conn.disconnect();
+        ++c.count;
+        });
+    hub.signals().emit("a");
+    hub.signals().emit("a");
+    if (c.count != 4 || hub.signals().find("a")->size() != 0) {
+        fail("激发快速路径存在bug");
+    }
+
+    // 超过内联容量之后仍然去重
+    SmallSet<int, 4> set;
+    for (int i = 0; i < 20; ++i) {
+        set.insert(i % 10);
+    }
+    if (set.size() != 10 || set.insert(3) || !set.insert(10) || ::std::accumulate(set.begin(), set.end(), 0) != 55) {
+        fail("小集合存在bug");
+    }
+}
+
+#if SS_COROUTINE
+
+// 连续等待两次激发，累加数据
+static CoSlot accumulate(A &a, int &sum) {
+    auto d = co_await a.signals().next("a");
+    sum += d->toInt();
+    d = co_await a.signals().next("a");
+    sum += d->toInt();
+}
+
+void test21()
+{
+    // 测试 co_await 等待信号
+    A a;
+    a.signals().registerr("a");
+    a.signals().registerr("b");
+    a.signals().registerr("c");
+    int sum = 0;
+    accumulate(a, sum).start();
+    if (sum != 0 || !a.signals().isConnected("a")) {
+        fail("协程等待信号存在bug");
+    }
+    a.signals().emit("a", com::_V(1));
+    a.signals().emit("a", com::_V(2));
+    a.signals().emit("a", com::_V(4));
+    if (sum != 3 || a.signals().isConnected("a")) {
+        fail("协程等待信号存在bug");
+    }
+
+    // 测试协程插槽，激发时不执行，由 executor 执行，之后在 dispatcher 中恢复
+    Dispatcher executor;
+    int got = 0;
+    a.signals().connect("b", [&](Slot::data_type d) -> CoSlot {
+        got += d->toInt();
+        co_await a.signals().next("c", executor);
+        got += 10;
+        }, executor);
+    a.signals().emit("b", com::_V(1));
+    if (got != 0 || executor.poll() != 1 || got != 1) {
+        fail("协程插槽存在bug");
+    }
+    a.signals().emit("c");
+    if (got != 1 || executor.poll() != 1 || got != 11) {
+        fail("协程插槽存在bug");
+    }
+
+    // executor 析构时没有开始的协程随之销毁
+    {
+        Dispatcher dropped;
+        auto conn = a.signals().connect("b", [&](Slot::data_type) -> CoSlot {
+            ++got;
+            co_return;
+            }, dropped);
+        a.signals().emit("b", com::_V(0));
+        conn.disconnect();
+    }
+    if (got != 11) {
+        fail("协程插槽存在bug");
+    }
+}
+
+#endif
+
 int main() {
     test0();
     test1();
     test2();
     test3();
-    return 0;
+    test4();
+    test5();
+    test6();
+    test7();
+    test8();
+    test9();
+    test10();
+    test11();
+    test12();
+    test13();
+    test14();
+    test15();
+    test16();
+    test17();
+    test18();
+    test19();
+    test20();
+    test22();
+    test23();
+    test24();
+    test25();
+    test26();
+#if SS_COROUTINE
+    test21();
+#endif
+    return failures ? 1 : 0;
 }
\ No newline at end of file
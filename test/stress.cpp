@@ -0,0 +1,344 @@
+#include "../src/signals.hpp"
+
+#include <thread>
+
+#if !SS_THREADSAFE
+#error "压力测试需要使用 SS_THREADSAFE=1 编译"
+#endif
+
+USE_SS;
+using namespace std;
+
+static atomic<size_t> received(0);
+
+static atomic<size_t> onced(0);
+
+class Listener : public Object {
+public:
+
+    ~Listener() {
+        // 插槽访问自身状态，析构前先断开并等待其他线程中的emit结束
+        signals().clear();
+        Signals::synchronize();
+    }
+
+    void proc(Slot &) {
+        ++count;
+        ++received;
+    }
+
+    atomic<size_t> count{0};
+};
+
+class Hub : public Object {
+public:
+
+    Signal<int> changed{this};
+};
+
+int main() {
+    const size_t THREADS = max(4u, thread::hardware_concurrency());
+    const size_t ROUNDS = 2000;
+
+    // 所有线程共享的信号源
+    Object hub;
+    hub.signals().registerr("tick");
+
+    // 所有线程共享的接收方，连接到各个线程中临时的信号源
+    Listener sink;
+
+    // 队列连接，所有线程激发的信号在同一个线程中执行
+    Dispatcher dispatcher;
+    size_t queued = 0;
+    hub.signals().connect("tick", [&](Slot &) {
+        ++queued;
+        }, dispatcher);
+    thread consumer([&]() {
+        dispatcher.run();
+    });
+
+    // 多个线程激发，多个消费者从阻塞的通道中读取
+    Object stream;
+    stream.signals().registerr("stream");
+    Channel channel(64);
+    stream.signals().connect("stream", channel);
+    atomic<size_t> streamed(0);
+    vector<thread> readers;
+    for (size_t i = 0; i < 2; ++i) {
+        readers.emplace_back([&]() {
+            Slot::data_type buf[16];
+            size_t n;
+            while ((n = channel.wait(buf, 16)) != 0) {
+                streamed += n;
+            }
+        });
+    }
+
+    // 粘性信号，和其他线程的激发并发连接，once插槽都通过补发收到一次数据
+    Object state;
+    state.signals().registerr("state", 1);
+    state.signals().emit("state", com::_V(0));
+    atomic<size_t> replayed(0);
+
+    // 所有线程同时第一次使用，Signals和插槽列表只创建一份
+    Object lazy;
+
+    // 多个线程同时激发并发插槽，共享同一个线程池
+    const size_t FANOUT = 8;
+    Object fan;
+    fan.signals().registerr("fan");
+    atomic<size_t> fanned(0);
+    for (size_t i = 0; i < FANOUT; ++i) {
+        fan.signals().connect("fan", [&](Slot &) {
+            ++fanned;
+        }).concurrent();
+    }
+
+    vector<thread> threads;
+    for (size_t i = 0; i < THREADS; ++i) {
+        threads.emplace_back([&]() {
+            lazy.signals().registerr("lazy");
+            lazy.signals().connect("lazy", [&](Slot &) {
+                ++received;
+            });
+
+            for (size_t r = 0; r < ROUNDS; ++r) {
+                {
+                    // 连接到共享的信号源后析构，和其他线程的emit并发
+                    Listener l;
+                    hub.signals().connect("tick", &Listener::proc, &l);
+                    hub.signals().once("tick", [&](Slot &) {
+                        ++onced;
+                    });
+                    hub.signals().emit("tick");
+                }
+
+                {
+                    // 通过句柄断开，和其他线程的emit以及compact并发
+                    ScopedConnection conn = hub.signals().connect("tick", [&](Slot &) {
+                        ++received;
+                    });
+                }
+
+                {
+                    // 临时信号源析构，和其他线程并发地修改sink的反向连接
+                    Object src;
+                    src.signals().registerr("local");
+                    src.signals().connect("local", &Listener::proc, &sink);
+                    src.signals().emit("local");
+                }
+
+                hub.signals().emit("tick");
+                fan.signals().emit("fan");
+                stream.signals().emit("stream", com::_V((int)r));
+
+                state.signals().once("state", [&](Slot &) {
+                    ++replayed;
+                });
+                state.signals().emit("state", com::_V((int)r));
+            }
+        });
+    }
+
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    bool failed = false;
+
+    // 剩余的once插槽在最后一次激发后全部移除
+    hub.signals().emit("tick");
+    if (hub.signals().find("tick")->size() != 1) {
+        cerr << "对象析构后插槽没有断开" << endl;
+        failed = true;
+    }
+
+    if (lazy.signals().find("lazy")->size() != THREADS) {
+        cerr << "延迟创建的信号存在多份" << endl;
+        failed = true;
+    }
+
+    // 断开后队列中还没有执行的插槽会被跳过，先等待dispatcher执行完再断开
+    dispatcher.post([&]() {
+        dispatcher.stop();
+    });
+    consumer.join();
+    hub.signals().disconnect("tick");
+
+    if (onced != THREADS * ROUNDS) {
+        cerr << "once插槽激发次数错误 " << onced << endl;
+        failed = true;
+    }
+    if (sink.count != THREADS * ROUNDS) {
+        cerr << "sink激发次数错误 " << sink.count << endl;
+        failed = true;
+    }
+    if (queued != THREADS * ROUNDS * 2 + 1) {
+        cerr << "队列连接激发次数错误 " << queued << endl;
+        failed = true;
+    }
+    channel.close();
+    for (auto &t : readers) {
+        t.join();
+    }
+    if (streamed != THREADS * ROUNDS) {
+        cerr << "通道读取数量错误 " << streamed << endl;
+        failed = true;
+    }
+
+    if (replayed != THREADS * ROUNDS || state.signals().isConnected("state")) {
+        cerr << "粘性信号补发次数错误 " << replayed << endl;
+        failed = true;
+    }
+
+    if (fanned != THREADS * ROUNDS * FANOUT) {
+        cerr << "并发插槽激发次数错误 " << fanned << endl;
+        failed = true;
+    }
+    if (received < THREADS * ROUNDS * 2) {
+        cerr << "插槽激发次数错误 " << received << endl;
+        failed = true;
+    }
+
+    // 粘性信号，一个线程按顺序激发，其他线程并发连接普通插槽，每个插槽收到的数据连续递增，没有重复和遗漏
+    {
+        Object seq;
+        seq.signals().registerr("seq", 4);
+        atomic<bool> running(true);
+        atomic<size_t> broken(0);
+        thread emitter([&]() {
+            for (int v = 1; running; ++v) {
+                seq.signals().emit("seq", com::_V(v));
+            }
+        });
+
+        vector<thread> watchers;
+        for (size_t i = 0; i < THREADS; ++i) {
+            watchers.emplace_back([&]() {
+                for (size_t r = 0; r < ROUNDS / 10; ++r) {
+                    mutex mtx;
+                    int last = 0;
+                    Connection conn = seq.signals().connect("seq", [&](Slot &s) {
+                        lock_guard<mutex> lck(mtx);
+                        int v = s.data->toInt();
+                        if (last && v != last + 1)
+                            ++broken;
+                        last = v;
+                    });
+                    this_thread::yield();
+                    conn.disconnect();
+
+                    // 插槽引用了栈上的变量，等待其他线程中已经开始的激发结束
+                    Signals::synchronize();
+                }
+            });
+        }
+        for (auto &t : watchers) {
+            t.join();
+        }
+        running = false;
+        emitter.join();
+
+        if (broken) {
+            cerr << "粘性信号数据重复或者乱序 " << broken << endl;
+            failed = true;
+        }
+    }
+
+    // 一直连接的插槽，其他线程并发地连接和断开，每次激发都必须调用到，不能被判断为没有连接而跳过
+    {
+        Object live;
+        live.signals().registerr("live");
+        size_t hits = 0;
+        live.signals().connect("live", [&](Slot &) {
+            ++hits;
+        });
+
+        atomic<bool> running(true);
+        vector<thread> churners;
+        for (size_t i = 0; i < THREADS; ++i) {
+            churners.emplace_back([&]() {
+                while (running) {
+                    ScopedConnection conn = live.signals().connect("live", [](Slot &) {});
+                }
+            });
+        }
+        const size_t EMITS = ROUNDS * 50;
+        for (size_t i = 0; i < EMITS; ++i) {
+            live.signals().emit("live");
+        }
+        running = false;
+        for (auto &t : churners) {
+            t.join();
+        }
+        Signals::synchronize();
+
+        if (hits != EMITS) {
+            cerr << "并发连接断开时一直连接的插槽漏掉了激发 " << hits << endl;
+            failed = true;
+        }
+    }
+
+    // 信号名称，多个线程并发分配新的id，同时不加锁地查找已有的名称
+    {
+        signal_t tick = SignalNames::find("tick");
+        atomic<size_t> mismatched(0);
+        vector<thread> namers;
+        for (size_t i = 0; i < THREADS; ++i) {
+            namers.emplace_back([&, i]() {
+                for (size_t r = 0; r < ROUNDS / 4; ++r) {
+                    string name = "stress." + to_string(i) + "." + to_string(r);
+                    signal_t sig = SignalNames::intern(name);
+                    if (SignalNames::find(name) != sig || SignalNames::find("tick") != tick)
+                        ++mismatched;
+                }
+            });
+        }
+        for (auto &t : namers) {
+            t.join();
+        }
+        if (mismatched) {
+            cerr << "并发分配信号id存在错误 " << mismatched << endl;
+            failed = true;
+        }
+    }
+
+    // 类型化信号，多个线程并发激发，同时通过句柄连接和断开，once插槽只调用一次
+    {
+        Hub typed;
+        atomic<bool> running(true);
+        thread emitter([&]() {
+            while (running) {
+                typed.changed.emit(1);
+            }
+        });
+
+        vector<thread> workers;
+        atomic<size_t> fired(0);
+        for (size_t i = 0; i < THREADS; ++i) {
+            workers.emplace_back([&]() {
+                for (size_t r = 0; r < ROUNDS; ++r) {
+                    ScopedConnection conn = typed.changed.connect([&](int v) {
+                        received += v;
+                    });
+                    typed.changed.once([&](int) {
+                        ++fired;
+                    });
+                    typed.changed.emit(1);
+                }
+            });
+        }
+        for (auto &t : workers) {
+            t.join();
+        }
+        running = false;
+        emitter.join();
+        Signals::synchronize();
+
+        if (fired != THREADS * ROUNDS || typed.changed.isConnected()) {
+            cerr << "类型化信号的once插槽激发次数错误 " << fired << endl;
+            failed = true;
+        }
+    }
+    return failed ? 1 : 0;
+}